@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <termios.h>
 
 using namespace std;
@@ -14,6 +15,16 @@ namespace tsw::common
         bool recordFilter;
         bool showBoxes;
         bool moveCamera;
+        bool recordDetections;
+        int maxFrameAge;
+    };
+
+    struct ColorCacheConfig
+    {
+        int maxFrames;
+        int maxTime;
+        double minIoU;
+        float maxConfidenceChange;
     };
 
     struct OfficerInferenceBox
@@ -31,11 +42,84 @@ namespace tsw::common
         double y;
     };
 
+    enum OfficerRegion
+    {
+        OutsideRegions = 0,
+        TargetRegion = 1,
+        SafeRegion = 2
+    };
+
     struct OfficerDirection
     {
         bool foundOfficer;
         bool shouldMove;
         Vector2 movement;
+        Vector2 size;
+        OfficerRegion region;
+    };
+
+    struct TrackerConfig
+    {
+        bool enabled;
+        double alpha;
+        double beta;
+        int leadTime;
+        double deadband;
+        int maxMisses;
+        bool velocityControl;
+        double velocityGain;
+    };
+
+    struct MotionGatingConfig
+    {
+        bool enabled;
+        double maxSlewRate;
+        bool compensate;
+    };
+
+    struct AdaptiveReadoutConfig
+    {
+        bool enabled;
+        int wideBinning;
+        double trackingCrop;
+        int stableFrames;
+        int lostFrames;
+        int holdFrames;
+    };
+
+    struct FrameRateGovernorConfig
+    {
+        bool enabled;
+        double minRate;
+        double maxRate;
+        double step;
+        int interval;
+        double maxLoad;
+        int raiseIntervals;
+        int maxBacklog;
+    };
+
+    struct GimbalEstimate
+    {
+        Vector2 angles;
+        Vector2 velocity;
+        int64_t timeUs;
+        bool isKnown;
+        bool isMoving;
+    };
+
+    struct TrajectoryWaypoint
+    {
+        Vector2 angles;
+        int dwell;
+    };
+
+    struct MotorCommand
+    {
+        uint sequence;
+        unsigned char action;
+        double horizontal;
+        double vertical;
     };
 
     struct ByteVector2
@@ -54,11 +138,19 @@ namespace tsw::common
     {
         Bounds angleBounds;
         Bounds stepBounds;
+        double maxSpeed;
+    };
+
+    struct ThreadConfig
+    {
+        vector<int> cpus;
+        int fifoPriority;
     };
 
     struct SerialConfig
     {
         string path;
         speed_t baudRate;
+        bool lowLatency;
     };
 }
\ No newline at end of file
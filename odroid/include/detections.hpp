@@ -0,0 +1,90 @@
+#pragma once
+
+#include "common.hpp"
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstdint>
+
+#define DETECTIONS_MAGIC "TSWD"
+#define DETECTIONS_VERSION 1
+
+#define DETECTION_FLAG_GUIDED 0x01
+#define DETECTION_FLAG_FOUND_OFFICER 0x02
+#define DETECTION_FLAG_SHOULD_MOVE 0x04
+#define DETECTION_FLAG_COMMAND_ISSUED 0x08
+#define DETECTION_FLAG_HAS_CHOSEN_BOX 0x10
+#define DETECTION_FLAG_STALE 0x20
+#define DETECTION_FLAG_SLEWING 0x40
+
+using namespace std;
+using namespace tsw::common;
+
+namespace tsw::detections
+{
+    // Everything in here goes straight to disk, so no padding allowed.
+    #pragma pack(push, 1)
+    struct DetectionFileHeader
+    {
+        char magic[4];
+        uint16_t version;
+        uint16_t headerSize;
+        uint32_t frameWidth;
+        uint32_t frameHeight;
+        double fps;
+    };
+
+    struct DetectionFrameRecord
+    {
+        uint64_t frameIndex;
+        int64_t timestampUs;
+        uint16_t boxCount;
+        uint8_t flags;
+        uint8_t region;
+        OfficerInferenceBox chosenBox;
+        float movementX;
+        float movementY;
+        uint8_t commandAction;
+        float commandHorizontal;
+        float commandVertical;
+    };
+    #pragma pack(pop)
+
+    struct DetectionFrame
+    {
+        DetectionFrameRecord record;
+        vector<OfficerInferenceBox> boxes;
+    };
+
+    class DetectionWriter
+    {
+    public:
+        DetectionWriter();
+        void Open(string fileName, int frameWidth, int frameHeight, double fps);
+        void Close();
+        bool IsOpen();
+        void WriteFrame(DetectionFrameRecord record, vector<OfficerInferenceBox>& boxes);
+        ~DetectionWriter();
+
+    private:
+        ofstream _file;
+        char _fileBuffer[65536];
+    };
+
+    class DetectionReader
+    {
+    public:
+        DetectionReader(string fileName);
+        DetectionFileHeader GetHeader();
+        size_t GetFrameCount();
+        DetectionFrame GetFrame(size_t frameNum);
+        ~DetectionReader();
+
+    private:
+        int _file;
+        const unsigned char* _data;
+        size_t _size;
+        vector<size_t> _frameOffsets;
+        void IndexFrames();
+    };
+}
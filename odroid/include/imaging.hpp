@@ -3,11 +3,27 @@
 #include "Spinnaker.h"
 #include "SpinGenApi/SpinnakerGenApi.h"
 #include "opencv2/opencv.hpp"
+#include "opencv2/core/parallel/parallel_backend.hpp"
 #include "utilities.hpp"
 #include "io.hpp"
 #include "common.hpp"
+#include "detections.hpp"
 #include <string>
 #include <future>
+#include <array>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+#define CLOCK_SYNC_INTERVAL_US 5000000
+#define CLOCK_SYNC_SAMPLES 5
+#define CAMERA_RECONNECT_INITIAL_MS 100
+#define CAMERA_RECONNECT_MAX_MS 5000
+#define MAX_OFFICER_TRACKS 16
+#define TRACK_MIN_IOU 0.3
+#define TRACK_MAX_MISSES 5
+#define READOUT_EDGE_MARGIN 0.05
+#define GOVERNOR_MAX_DROP_PROPORTION 0.02
 
 using namespace std;
 using namespace Spinnaker;
@@ -16,13 +32,31 @@ using namespace cv;
 using namespace tsw::utilities;
 using namespace tsw::io;
 using namespace tsw::common;
+using namespace tsw::detections;
 
 namespace tsw::imaging
 {
+    struct FrameTiming
+    {
+        // This one is in the camera's clock, the other two are in ours.
+        uint64_t sensorTimestampNs;
+        int64_t exposureUs;
+        int64_t receivedUs;
+    };
+
+    struct CameraReadout
+    {
+        // Binning shrinks the frame without losing any of the view, crop keeps the middle of the view at full detail.
+        int binning;
+        double crop;
+    };
+
     struct LiveFeedCallbackArgs
     {
         ImagePtr image;
         size_t imageIndex;
+        FrameTiming timing;
+        CameraReadout readout;
     }; 
 
     struct LiveFeedCallback
@@ -31,6 +65,47 @@ namespace tsw::imaging
         uint callbackKey;
     };
 
+    enum CameraConnectionState
+    {
+        CameraConnected = 0,
+        CameraLost = 1
+    };
+
+    struct ConnectionCallback
+    {
+        function<void(CameraConnectionState)> callback;
+        uint callbackKey;
+    };
+
+
+    class CameraProperties
+    {
+    public:
+        CameraProperties();
+        void Attach(INodeMap& nodeMap);
+        void Detach();
+        void Forget();
+        bool IsAvailable(string name);
+        int64_t GetInt(string name);
+        int64_t GetIncrement(string name);
+        double GetFloat(string name);
+        void SetInt(string name, int64_t value);
+        void SetFloat(string name, double value);
+        void SetBool(string name, bool value);
+        void SetEnum(string name, int64_t value);
+
+    private:
+        INodeMap* _nodeMap;
+        map<string, INode*> _nodes;
+        map<string, double> _written;
+        map<string, double> _applied;
+        map<string, double> _read;
+        mutex _lock;
+        INode* GetNode(string name);
+        INode* FindNode(string name);
+        bool IsUnchanged(string name, double value);
+        void Remember(string name, double requested, double applied);
+    };
 
     class FlirCamera
     {
@@ -46,11 +121,21 @@ namespace tsw::imaging
         void SetFrameHeight(int frameHeight);
         void SetFrameWidth(int frameWidth);
         void SetFrameRate(double hertz);
+        void BeginConfiguration();
+        void CommitConfiguration();
         void StartLiveFeed();
         void StopLiveFeed();
         bool IsLiveFeedOn();
+        void EnterStandby(double hertz);
+        void ExitStandby();
+        bool IsInStandby();
+        void SetReadout(CameraReadout readout);
+        CameraReadout GetReadout();
         uint RegisterLiveFeedCallback(function<void(LiveFeedCallbackArgs)> callback);
         void UnregisterLiveFeedCallback(uint callbackKey);
+        uint RegisterConnectionCallback(function<void(CameraConnectionState)> callback);
+        void UnregisterConnectionCallback(uint callbackKey);
+        bool IsConnected();
         ImagePtr CaptureImage();
         void SetFilter(RgbTransformLightSourceEnums filter);
 
@@ -62,7 +147,16 @@ namespace tsw::imaging
         bool _isLiveFeedOn;
         list<LiveFeedCallback> _liveFeedCallbacks;
         future<void> _liveFeedFuture;
-        bool _isConnected;
+        list<ConnectionCallback> _connectionCallbacks;
+        SmartLock _connectionCallbacksLock;
+        uint _nextConnectionKey;
+        mutex _connectionLock;
+        condition_variable _connectionCondition;
+        EventSignal _lostSignal;
+        future<void> _supervisorFuture;
+        bool _isSupervising;
+        mutex _configurationLock;
+        atomic<bool> _isConnected;
         bool _shouldBeConnected;
         string _connectedSerialNumber;
         int* _userFrameHeight;
@@ -70,31 +164,66 @@ namespace tsw::imaging
         double* _userFrameRate;
         int _bufferCount;
         RgbTransformLightSourceEnums* _userFilter;
+        atomic<int64_t> _clockOffsetUs;
+        atomic<bool> _hasClockOffset;
+        atomic<int64_t> _lastClockSyncUs;
+        future<void> _clockSyncFuture;
+        atomic<bool> _isInStandby;
+        double _standbyFrameRate;
+        CameraProperties _properties;
+        bool _isConfiguring;
+        CameraReadout _readout;
+        CameraReadout _activeReadout;
+        atomic<bool> _isReadoutPending;
 
         void RunLiveFeed();
-        void OnLiveFeedImageReceived(ImagePtr image, uint imageIndex);
+        void OnLiveFeedImageReceived(ImagePtr image, uint imageIndex, FrameTiming timing);
+        void SyncClock();
+        void StartClockSync();
+        void WaitForClockSync();
+        FrameTiming GetFrameTiming(ImagePtr image, int64_t receivedUs);
         bool TryConnect(string serialNumber, CameraPtr* camera);
-        void WaitForConnected(bool attemptToConnect = false);
+        void SetConnected(bool isConnected);
+        void WaitForConnected();
+        bool WaitForReconnect();
         void EnsureConnectionNotLost();
-        void PowerCycle();
+        void StartSupervisor();
+        void StopSupervisor();
+        void Supervise();
+        void Reconnect();
+        void PublishConnectionState(CameraConnectionState state);
+        void ApplyConfiguration();
+        void WriteConfiguration();
+        bool RecoverAcquisition();
+        void SwitchReadout();
+        int GetReadoutSize(string size, string maxSize, int* userValue);
+        void ApplyGeometry(string size, string offset, string maxSize, int value);
     };
 
     class Recorder
     {
     public:
         Recorder(Size frameSize, double fps);
+        string Name;
         void StartRecording(string fileName);
         void StopRecording();
         bool IsRecording();
-        void AddFrame(Mat frame);
+        void AddFrame(Mat frame, int64_t frameIndex = -1, int64_t timeUs = -1);
 
     private:
+        struct BufferedFrame
+        {
+            Mat frame;
+            int64_t frameIndex;
+            int64_t timeUs;
+        };
         bool _isRecording;
         string _recordedFileName;
         uint _callbackKey;
         VideoWriter _aviWriter;
-        queue<Mat> _frameBuffer;
+        queue<BufferedFrame> _frameBuffer;
         SmartLock _frameBufferLock;
+        EventSignal _frameSignal;
         future<void> _recordFuture;
         Size _frameSize;
         double _fps;
@@ -110,24 +239,21 @@ namespace tsw::imaging
         float ConfidenceThreshold;
         OfficerDirection FindOfficer(ImagePtr image);
         OfficerDirection FindOfficer(ImagePtr image, OfficerInferenceBox* officerBox);
+        OfficerDirection FindOfficer(OfficerInferenceBox* officerBox, int frameWidth, int frameHeight);
         OfficerInferenceBox* GetOfficerBox(ImagePtr image);
+        OfficerInferenceBox* GetOfficerBox(ImagePtr image, vector<OfficerInferenceBox>& officerBoxes);
         vector<OfficerInferenceBox> GetOfficerLocations(ImagePtr image);
+        vector<OfficerInferenceBox> GetOfficerLocations(vector<InferenceBoundingBox>& rawBoxes, int frameWidth, int frameHeight);
 
     protected:
         OfficerLocator(int16_t officerClassId);
         virtual OfficerInferenceBox* GetDesiredOfficerBox(vector<OfficerInferenceBox> officerBoxes, ImagePtr image) = 0;    
 
     private:
-        enum RegionLocation
-        {
-            None,
-            Target,
-            Safe
-        };
         bool _isTravelingToTarget;
-        RegionLocation _lastLocation;
-        RegionLocation GetRegionLocation(Vector2 location, ImagePtr image);
-        static bool IsPointInRegion(Vector2 location, Vector2 region, ImagePtr image);
+        OfficerRegion _lastLocation;
+        OfficerRegion GetRegionLocation(Vector2 location, int frameWidth, int frameHeight);
+        static bool IsPointInRegion(Vector2 location, Vector2 region, int frameWidth, int frameHeight);
         static short CleanCoordinate(short coordinate, short max);
     };
 
@@ -140,6 +266,40 @@ namespace tsw::imaging
         OfficerInferenceBox* GetDesiredOfficerBox(vector<OfficerInferenceBox> officerBoxes, ImagePtr image);
     };
 
+    struct OfficerTrack
+    {
+        bool active;
+        int id;
+        OfficerInferenceBox box;
+        int age;
+        int hits;
+        int misses;
+        bool confirmed;
+        float colorScore;
+        OfficerInferenceBox verifiedBox;
+        int verifiedAge;
+        int64_t verifiedUs;
+    };
+
+    class OfficerTrackManager
+    {
+    public:
+        OfficerTrackManager();
+        void Update(vector<OfficerInferenceBox>& boxes);
+        OfficerTrack* SelectTarget();
+        array<OfficerTrack, MAX_OFFICER_TRACKS>& GetTracks();
+        void Reset();
+        static double IoU(OfficerInferenceBox& first, OfficerInferenceBox& second);
+
+    private:
+        array<OfficerTrack, MAX_OFFICER_TRACKS> _tracks;
+        int _nextId;
+        int _targetId;
+        OfficerTrack* FindTrack(int id);
+        OfficerTrack* GetFreeSlot();
+        static double MatchScore(OfficerInferenceBox& trackBox, OfficerInferenceBox& box);
+    };
+
     class SmartOfficerLocator : public OfficerLocator
     {
     public:
@@ -147,9 +307,16 @@ namespace tsw::imaging
         Scalar MinHSV;
         Scalar MaxHSV;
         double OfficerThreshold;
+        OfficerTrackManager Tracks;
+        ColorCacheConfig ColorCache;
+        OfficerInferenceBox* GetDesiredOfficerBox(vector<OfficerInferenceBox> officerBoxes, Mat frame);
+        float GetColorScore(OfficerInferenceBox box, Mat frame);
     
     protected:
         OfficerInferenceBox* GetDesiredOfficerBox(vector<OfficerInferenceBox> officerBoxes, ImagePtr image);
+
+    private:
+        bool IsCachedScoreValid(OfficerTrack& track, int64_t nowUs, bool* isExpired);
     };
 
     class TestOfficerLocator : public OfficerLocator
@@ -180,15 +347,53 @@ namespace tsw::imaging
         Mat _currentFrame;
         int _refreshRate;
         SmartLock _displayLock;
+        EventSignal _frameSignal;
         Mat MatFromImage(ImagePtr image);
         void RunWindow();
     };
 
+    class FrameRateGovernor
+    {
+    public:
+        FrameRateGovernor(FlirCamera& camera, FrameRateGovernorConfig config, double frameRate);
+        ~FrameRateGovernor();
+        void Start();
+        void Stop();
+        bool IsGoverning();
+        double GetFrameRate();
+
+    private:
+        FlirCamera* _camera;
+        FrameRateGovernorConfig _config;
+        atomic<double> _frameRate;
+        bool _isGoverning;
+        future<void> _governFuture;
+        EventSignal _stopSignal;
+        void Govern();
+        double GetTotal(HistogramSummary& summary);
+        bool ChangeFrameRate(double hertz, string reason);
+    };
+
+    class ExecutorParallelBackend : public cv::parallel::ParallelForAPI
+    {
+    public:
+        ExecutorParallelBackend(StealingPool& pool);
+        void parallel_for(int tasks, FN_parallel_for_body_cb_t bodyCallback, void* callbackData);
+        int getThreadNum() const;
+        int getNumThreads() const;
+        int setNumThreads(int numThreads);
+        const char* getName() const;
+
+    private:
+        StealingPool* _pool;
+    };
+
     class ImageProcessor
     {
     public:
         ImageProcessor(DisplayWindow& window, FlirCamera& camera, SmartOfficerLocator& officerLocator, CameraMotionController& motionController, ImageProcessingConfig config);
         uint CameraFramesToSkip;
+        AdaptiveReadoutConfig AdaptiveReadout;
         void StartProcessing();
         void StopProcessing();
         bool IsProcessing();
@@ -197,16 +402,29 @@ namespace tsw::imaging
     private:
         Recorder* _footageRecorder;
         Recorder* _filterRecorder;
+        DetectionWriter* _detectionWriter;
         DisplayWindow* _window;
         FlirCamera* _camera;
         SmartOfficerLocator* _officerLocator;
         CameraMotionController* _motionController;
         uint _livefeedCallbackKey;
+        uint _connectionCallbackKey;
         bool _isProcessing;
+        Size _frameSize;
+        int _stableFrames;
+        int _lostFrames;
+        bool _isReadoutNarrow;
+        CameraReadout _lastReadout;
+        int _framesSinceSwitch;
         unsigned int _processNum;
         ImageProcessingConfig _config;
         void OnLiveFeedImageReceived(LiveFeedCallbackArgs args);
+        void OnCameraConnectionChanged(CameraConnectionState state);
+        void UpdateReadout(LiveFeedCallbackArgs& args, OfficerInferenceBox* bestBox);
+        OfficerInferenceBox ToFullFrame(OfficerInferenceBox box, LiveFeedCallbackArgs& args);
         void DrawOfficerBox(OfficerInferenceBox* box, Mat* cvImage, Scalar color);
-        Mat MatFromImage(ImagePtr image, OfficerInferenceBox* officerBox);
+        void WriteDetections(LiveFeedCallbackArgs& args, vector<OfficerInferenceBox>& boxes, OfficerInferenceBox* bestBox, OfficerDirection* dir, bool commandIssued, bool stale, bool slewing);
+        void LogLatencyReport();
+        Mat MatFromImage(ImagePtr image);
     };
 }
\ No newline at end of file
@@ -8,6 +8,8 @@
 #include "utilities.hpp"
 #include <termios.h>
 #include <future>
+#include <array>
+#include <mutex>
 
 #define LED_ON 255
 #define LED_OFF 0
@@ -17,6 +19,30 @@
 #define HEADLIGHTS_OFFICER_VISIBLE 0x01
 #define HEADLIGHTS_MOVING_TO_OFFICER 0x02
 
+// A measurement further than this many officer widths from the prediction starts a new track.
+#define TRACKER_GATE_SIZES 3
+
+// The velocity timeout goes across in one byte, in these units.
+#define VELOCITY_TIMEOUT_UNIT_MS 10
+
+// Velocity commands only last this long, so if we die the motors stop on their own.
+#define VELOCITY_TIMEOUT_MS 250
+
+// Don't bother sending a new velocity unless it changed by at least this much, in degrees per second.
+#define VELOCITY_RESEND_DELTA 0.5
+
+// How many waypoints the motors have room for.
+#define TRAJECTORY_MAX_WAYPOINTS 16
+
+// How long the search sweep sits at each end before heading back.
+#define SEARCH_DWELL_MS 500
+
+// How many motions back the odometry can look, so frames from a little while ago can still be placed.
+#define ODOMETRY_HISTORY 32
+
+// The speed the motors boot up with, before anybody sets one.
+#define DEFAULT_MOTOR_SPEED 127
+
 using namespace Spinnaker;
 using namespace std;
 using namespace rapidjson;
@@ -28,9 +54,11 @@ namespace tsw::io
     class SerialPort
     {
     public:
-        SerialPort(speed_t baudRate);
+        SerialPort(speed_t baudRate, bool lowLatency = false);
         void Open(string devicePath);
+        void Attach(int fd);
         int Read(unsigned char* buffer, int bytesToRead);
+        bool WaitForData(int timeoutMs);
         int Write(unsigned char* data, int bytesToWrite);
         void Clear();
         void Close();
@@ -39,7 +67,10 @@ namespace tsw::io
         
     private:
 	    speed_t _baudRate;
+        bool _lowLatency;
         int _port;
+        int _epoll;
+        void EnableLowLatency();
     };
 
     enum Device
@@ -68,9 +99,33 @@ namespace tsw::io
         Deactivate = 10,
         SetSpeeds = 11,
         Headlights = 12,
+        SetVelocity = 13,
+        Trajectory = 14,
         Acknowledge = 15
     };
 
+    // The first argument of a Trajectory command says what to do with it.
+    enum TrajectoryOpcode
+    {
+        TrajectoryClear = 0,
+        TrajectoryAddWaypoint = 1,
+        TrajectorySetDwell = 2,
+        TrajectoryExecute = 3,
+        TrajectoryAbort = 4
+    };
+
+    class DeviceMessageParser
+    {
+    public:
+        DeviceMessageParser();
+        bool Push(unsigned char byte, DeviceMessage* message);
+        static vector<unsigned char> Encode(Device device, CommandAction command, vector<unsigned char> data);
+
+    private:
+        Device _currentDevice;
+        int _bytesForCurrent;
+        vector<unsigned char> _currentMessage;
+    };
 
     class DeviceSerialPort
     {
@@ -85,10 +140,13 @@ namespace tsw::io
         void WriteToDevice(Device device, CommandAction command, unsigned char data);
         void WriteToDevice(Device device, CommandAction command);
         bool TryReadFromDevice(Device device, DeviceMessage* readMessage);
+        EventSignal& GetMessageSignal(Device device);
         ~DeviceSerialPort();
 
     private:
         bool _isGathering;
+        DeviceMessageParser _parser;
+        EventSignal _messageSignals[2];
         future<void> _gatherFuture;
         SerialPort* _port;
         vector<DeviceMessage> _buffer;
@@ -97,6 +155,55 @@ namespace tsw::io
         void WriteToDevice(vector<unsigned char> formattedData);
     };
 
+    class GimbalOdometry
+    {
+    public:
+        GimbalOdometry(MotorConfig panConfig, MotorConfig tiltConfig);
+        void SetSpeeds(ByteVector2 speeds, int64_t timeUs);
+        void MoveTo(Vector2 angles, bool isRelative, int64_t timeUs);
+        void SetVelocity(Vector2 velocity, int64_t timeoutUs, int64_t timeUs);
+        void FollowTrajectory(vector<TrajectoryWaypoint> waypoints, int loops, int64_t timeUs);
+        void Hold(int64_t timeUs);
+        void Arrived(int64_t timeUs);
+        void Forget(int64_t timeUs);
+        GimbalEstimate Estimate(int64_t timeUs);
+
+    private:
+        enum MotionType
+        {
+            Holding = 0,
+            Moving = 1,
+            Steering = 2,
+            Following = 3
+        };
+        struct MotionSegment
+        {
+            MotionType type;
+            int64_t startUs;
+            int64_t endUs;
+            Vector2 start;
+            Vector2 target;
+            Vector2 velocity;
+            Vector2 rates;
+            bool isKnown;
+            vector<TrajectoryWaypoint> waypoints;
+            int loops;
+        };
+        MotorConfig _panConfig;
+        MotorConfig _tiltConfig;
+        array<MotionSegment, ODOMETRY_HISTORY> _segments;
+        size_t _newest;
+        size_t _count;
+        Vector2 _rates;
+        mutex _lock;
+        void Push(MotionSegment segment);
+        MotionSegment Begin(MotionType type, int64_t timeUs);
+        MotionSegment* FindSegment(int64_t timeUs);
+        GimbalEstimate Evaluate(MotionSegment& segment, int64_t timeUs);
+        static Vector2 MoveTowards(Vector2 angles, Vector2 target, Vector2 rates, double seconds);
+        static double TimeToReach(Vector2 angles, Vector2 target, Vector2 rates);
+    };
+
     class MotorController
     {
     public:
@@ -107,22 +214,66 @@ namespace tsw::io
         void SendAsyncRelativeMoveCommand(double horizontal, double vertical);
         void SendSyncAbsoluteMoveCommand(double horizontal, double vertical);
         void SendAsyncAbsoluteMoveCommand(double horizontal, double vertical);
+        void SendVelocityCommand(double horizontalRate, double verticalRate, int timeout);
+        void UploadTrajectory(vector<TrajectoryWaypoint> waypoints);
+        void ExecuteTrajectory(unsigned char loops);
+        void AbortTrajectory();
+        bool IsTrajectoryRunning();
         unsigned char GetHeadlightsState();
         void SetHeadlightsState(unsigned char state);
         void Activate();
         void Deactivate();
         void SetSpeeds(ByteVector2 speeds);
         bool TryReadMessage(DeviceMessage* message);
+        MotorCommand GetLastCommand();
+        Vector2 GetCommandedAngles();
+        Vector2 GetCommandedVelocity();
+        int64_t GetVelocityTimeLeft();
+        GimbalEstimate EstimateAngles();
+        GimbalEstimate EstimateAngles(int64_t timeUs);
 
     private:
         unsigned char _headlightsState;
+        MotorCommand _lastCommand;
+        Vector2 _commandedAngles;
+        Vector2 _commandedVelocity;
+        int64_t _velocityStartUs;
+        atomic<int64_t> _velocityEndUs;
+        vector<TrajectoryWaypoint> _trajectory;
+        bool _isTrajectoryRunning;
+        GimbalOdometry _odometry;
         DeviceSerialPort* _commandPort;
         void SendMoveCommand(CommandAction moveType, double horizontal, double vertical, string moveName);
         void ReadAcknowledge();
         void ReadSuccess();
+        void SettleVelocity(int64_t nowUs);
+        void SendTrajectoryCommand(TrajectoryOpcode opcode, vector<unsigned char> args);
+        static void PackMotorValues(vector<unsigned char>& bytes, int start, int horizontalMotor, int verticalMotor);
         static int AngleToMotorValue(double angle, MotorConfig config);
     };
 
+    class OfficerTracker
+    {
+    public:
+        OfficerTracker();
+        TrackerConfig Config;
+        void Update(Vector2 angles, Vector2 size, int64_t timeUs);
+        bool Coast();
+        bool HasTrack();
+        Vector2 Predict(int64_t timeUs);
+        Vector2 GetVelocity();
+        Vector2 GetSize();
+        void Reset();
+
+    private:
+        bool _hasTrack;
+        Vector2 _position;
+        Vector2 _velocity;
+        Vector2 _size;
+        int64_t _timeUs;
+        int _misses;
+    };
+
     class CameraMotionController
     {
     public:
@@ -132,13 +283,29 @@ namespace tsw::io
         Vector2 HomeAngles;
         Bounds AngleXBounds;
         ByteVector2 MotorSpeeds;
+        OfficerTracker Tracker;
+        int GuidanceRate;
+        bool UseSearchTrajectory;
+        MotionGatingConfig MotionGating;
+        bool ArmedStandby;
+        void ArmGuidance();
+        void DisarmGuidance();
         void InitializeGuidance();
         void UninitializeGuidance();
         bool IsGuidanceInitialized();
+        void PauseGuidance();
+        void ResumeGuidance();
+        bool IsGuidancePaused();
         void GuideCameraTo(OfficerDirection location);
+        void GuideCameraTo(OfficerDirection location, int64_t frameTimeUs);
+        void SubmitTarget(OfficerDirection location, int64_t frameTimeUs);
+        bool ControlTick();
+        bool IsControlLoopRunning();
+        bool IsSlewing(int64_t frameTimeUs);
         void OfficerSearch();
         void GoToHome();
         void CalibrateFOV(int frameWidth, int frameHeight);
+        MotorCommand GetLastMotorCommand();
         static int GetMaxValue();
 
     private:
@@ -150,15 +317,45 @@ namespace tsw::io
         };
         MotorController* _motorController;
         bool _isGuidanceInitialized;
+        atomic<bool> _isGuidancePaused;
         uint _cameraLivefeedCallbackKey;
-        OfficerSearchState _searchState;
+        atomic<OfficerSearchState> _searchState;
         OfficerDirection _lastSeen;
         bool _movingTowardsMin;
+        bool _isOfficerVisible;
+        Vector2 _lastSeenAngles;
+        bool _hasLastSeenAngles;
+        mutex _targetLock;
+        OfficerDirection _pendingTarget;
+        int64_t _pendingFrameTimeUs;
+        int64_t _pendingSubmitUs;
+        bool _hasPendingTarget;
+        int64_t _lastFrameTimeUs;
+        atomic<bool> _isControlLoopRunning;
+        future<void> _controlLoopFuture;
+        future<void> _armFuture;
+        bool _isArming;
+        bool _isArmed;
+        bool _areMotorsActive;
         void ResetSearchState();
+        void PrepareMotors();
+        void WaitForArming();
+        void TrackOfficer(OfficerDirection location, int64_t frameTimeUs);
+        void AimAtPrediction();
+        void SteerTowards(Vector2 aim, Vector2 pointing);
+        Vector2 ToWorldAngles(OfficerDirection location, Vector2 pointing);
+        OfficerDirection CompensateForMotion(OfficerDirection location, int64_t frameTimeUs);
+        void RememberLastSeenAngles(OfficerDirection location, int64_t frameTimeUs);
+        double ClampPan(double angle);
+        void StartControlLoop();
+        void StopControlLoop();
+        void ControlLoop();
         void SendMoveCommand(unsigned char specifierByte, double horizontal, double vertical, string moveName);
         void CheckLastSeen();
         void MoveToMin();
         void MoveToMax();
+        void StartCircling();
+        void StopCircling();
         void Circle();
     };
 
@@ -173,6 +370,8 @@ namespace tsw::io
     public:
         CommandAgent(DeviceSerialPort& commandPort);
         Command* ReadCommand(Device device);
+        bool TryReadCommand(Device device, Command** readCommand);
+        EventSignal& GetCommandSignal(Device device);
         bool TryReadResponse(Device device, vector<unsigned char>* readResponse);
         void SendResponse(vector<unsigned char> formattedResponse);
         void SendCommand(Device device, Command* command);
@@ -182,6 +381,7 @@ namespace tsw::io
 
     protected:
         DeviceSerialPort* _commandPort;
+        static Command* ParseCommand(DeviceMessage message);
     };
 
     class StatusLED
@@ -202,6 +402,7 @@ namespace tsw::io
         bool _isFlashing;
         bool _isEnabled;
         future<void> _flashFuture;
+        EventSignal _stopSignal;
         void RunFlash();
         void SetBrightness(unsigned char brightness);
     };
@@ -28,6 +28,12 @@ namespace tsw::io::settings
         static SerialConfig ReadSerialConfig(Document& doc, string serialConfigName);
         static ImageProcessingConfig ReadImageProcessingConfig(Document& doc, string imageProcessingConfigName);
         static Scalar ReadHSV(Document& doc, string hsvName);
+        static map<string, ThreadConfig> ReadThreadConfigs(Document& doc, string threadConfigsName);
+        static TrackerConfig ReadTrackerConfig(Document& doc, string trackerConfigName);
+        static ColorCacheConfig ReadColorCacheConfig(Document& doc, string colorCacheConfigName);
+        static MotionGatingConfig ReadMotionGatingConfig(Document& doc, string motionGatingConfigName);
+        static AdaptiveReadoutConfig ReadAdaptiveReadoutConfig(Document& doc, string adaptiveReadoutConfigName);
+        static FrameRateGovernorConfig ReadFrameRateGovernorConfig(Document& doc, string frameRateGovernorConfigName);
 
     private:
         static bool ReadLogFlag(Document& doc, string logFlagsName, string flagName);
@@ -51,6 +57,7 @@ namespace tsw::io::settings
 	    Vector2 HomeAngles;
         Bounds AngleXBounds;
         double CameraFrameRate;
+        double CameraStandbyFrameRate;
         int CameraFrameWidth;
         int CameraFrameHeight;
         MotorConfig PanConfig;
@@ -65,6 +72,21 @@ namespace tsw::io::settings
         Scalar MaxOfficerHSV;
         double OfficerThreshold;
         ByteVector2 MotorSpeeds;
+        map<string, ThreadConfig> ThreadConfigs;
+        bool LockMemory;
+        int ThreadSampleInterval;
+        string MetricsPath;
+        int MetricsInterval;
+        string TracePath;
+        int TraceDuration;
+        TrackerConfig TrackingConfig;
+        ColorCacheConfig OfficerColorCache;
+        int GuidanceRate;
+        bool UseSearchTrajectory;
+        MotionGatingConfig MotionGating;
+        bool ArmedStandby;
+        AdaptiveReadoutConfig AdaptiveReadout;
+        FrameRateGovernorConfig FrameRateGovernor;
         void Load(string settingsFile);
 
     private:
@@ -0,0 +1,150 @@
+#pragma once
+
+#include "imaging.hpp"
+#include <string>
+#include <vector>
+#include <deque>
+#include <random>
+
+// How long after the ack the motors actually start doing what they were told.
+#define SIM_COMMAND_LATENCY_US 15000
+
+// Time from the frame being exposed to guidance acting on it.
+#define SIM_PROCESSING_LATENCY_US 25000
+
+// How big the officer looks, in degrees.
+#define SIM_OFFICER_WIDTH 2.5
+#define SIM_OFFICER_HEIGHT 6.0
+
+#define SIM_MOTORS_ACK 0x8f
+#define SIM_MOTORS_SUCCESS 0x81
+
+// Backstop for waiting on the gatherer, in case somebody else took its signal before we got to it.
+#define SIM_GATHER_WAIT_MS 5
+
+using namespace std;
+using namespace tsw::common;
+using namespace tsw::utilities;
+using namespace tsw::io;
+using namespace cv;
+using namespace Spinnaker;
+
+namespace tsw::simulation
+{
+    class GimbalPlant
+    {
+    public:
+        GimbalPlant(MotorConfig panConfig, MotorConfig tiltConfig, Vector2 startAngles);
+        void ApplyCommand(DeviceMessage& message, int64_t nowUs);
+        bool Update(int64_t nowUs);
+        Vector2 GetAngles();
+        bool IsActive();
+        uint GetMoveCount();
+
+    private:
+        struct PendingCommand
+        {
+            int64_t applyUs;
+            CommandAction action;
+            Vector2 angles;
+            ByteVector2 speeds;
+            int64_t timeoutUs;
+            TrajectoryOpcode opcode;
+            int value;
+        };
+        MotorConfig _panConfig;
+        MotorConfig _tiltConfig;
+        deque<PendingCommand> _pending;
+        Vector2 _angles;
+        Vector2 _target;
+        Vector2 _slewRates;
+        Vector2 _velocity;
+        int64_t _velocityEndUs;
+        bool _isVelocityMode;
+        vector<TrajectoryWaypoint> _trajectory;
+        bool _isTrajectoryRunning;
+        bool _isDwelling;
+        bool _trajectoryFinished;
+        size_t _trajectoryIndex;
+        double _dwellLeft;
+        int _loopsLeft;
+        bool _isActive;
+        bool _isSyncMove;
+        uint _moveCount;
+        int64_t _lastUpdateUs;
+        void AdvanceTo(int64_t nowUs);
+        void ApplyTrajectoryCommand(PendingCommand& command);
+        void Step(double seconds);
+        void StepTrajectory(double seconds);
+        static double MoveAxis(double angle, double target, double maxStep);
+        static double MotorValueToAngle(vector<unsigned char>& bytes, int start, MotorConfig config);
+    };
+
+    class VirtualMotors
+    {
+    public:
+        VirtualMotors(GimbalPlant& plant, Clock& clock);
+        int GetTswFd();
+        void WatchGatherer(EventSignal& messageSignal);
+        Vector2 GetAngles();
+        void Start();
+        void Stop();
+        void Update();
+        ~VirtualMotors();
+
+    private:
+        GimbalPlant* _plant;
+        Clock* _clock;
+        EventSignal* _messageSignal;
+        int _fds[2];
+        bool _isRunning;
+        mutex _plantLock;
+        DeviceMessageParser _parser;
+        future<void> _listenFuture;
+        void Listen();
+        void Send(unsigned char header);
+    };
+
+    struct OfficerWaypoint
+    {
+        int64_t timeUs;
+        Vector2 angles;
+        bool visible;
+    };
+
+    class ScriptedOfficer
+    {
+    public:
+        ScriptedOfficer(vector<OfficerWaypoint> waypoints);
+        static ScriptedOfficer FromScenario(string scenario, int64_t durationUs, Vector2 origin);
+        Vector2 GetAngles(int64_t nowUs);
+        bool IsVisible(int64_t nowUs);
+
+    private:
+        vector<OfficerWaypoint> _waypoints;
+        size_t FindSegment(int64_t nowUs);
+    };
+
+    class FrameRenderer
+    {
+    public:
+        FrameRenderer(int frameWidth, int frameHeight, double horizontalFov, double verticalFov, Scalar officerHSV, unsigned int seed);
+        int16_t OfficerClassId;
+        double PixelJitter;
+        double MissRate;
+        bool Render(Vector2 gimbalAngles, Vector2 officerAngles, bool officerVisible, vector<InferenceBoundingBox>& boxes);
+        Vector2 ToPixel(Vector2 gimbalAngles, Vector2 worldAngles);
+        Mat GetFrame();
+
+    private:
+        int _frameWidth;
+        int _frameHeight;
+        double _horizontalFov;
+        double _verticalFov;
+        Mat _frame;
+        Scalar _background;
+        Scalar _officerColor;
+        Rect _lastOfficerRect;
+        mt19937 _rng;
+    };
+}
@@ -2,8 +2,40 @@
 
 #include <string>
 #include <future>
+#include <functional>
+#include <map>
+#include <queue>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <sys/types.h>
+#include <chrono>
+#include <random>
+#include "common.hpp"
+
+#define ACQUISITION_GROUP "Acquisition"
+#define GUIDANCE_GROUP "Guidance"
+#define SERIAL_GROUP "SerialIO"
+#define ENCODING_GROUP "Encoding"
+#define DISPLAY_GROUP "Display"
+#define STATUS_GROUP "Status"
+#define COMPUTE_GROUP "Compute"
+
+#define HISTOGRAM_SUB_BUCKET_BITS 4
+#define HISTOGRAM_MAGNITUDES 40
+
+#define TRACE_BUFFER_CAPACITY 65536
+
+// Devices that are still enumerating get retried quickly at first, then less and less often.
+#define STARTUP_BACKOFF_INITIAL_MS 250
+#define STARTUP_BACKOFF_MAX_MS 8000
 
 using namespace std;
+using namespace tsw::common;
 
 namespace tsw::utilities
 {
@@ -21,6 +53,363 @@ namespace tsw::utilities
         string BuildDescriptor(string description);
     };
 
+    class Clock
+    {
+    public:
+        virtual int64_t NowUs() = 0;
+        static Clock& Current();
+        static void SetCurrent(Clock* clock);
+        virtual ~Clock() { }
+    };
+
+    class SystemClock : public Clock
+    {
+    public:
+        int64_t NowUs();
+    };
+
+    class VirtualClock : public Clock
+    {
+    public:
+        VirtualClock(int64_t startUs = 0);
+        int64_t NowUs();
+        void Advance(int64_t us);
+
+    private:
+        atomic<int64_t> _nowUs;
+    };
+
+    class EventSignal
+    {
+    public:
+        EventSignal();
+        EventSignal(const EventSignal&) = delete;
+        void Notify();
+        bool Wait(int timeoutMs = -1);
+        void Clear();
+        int GetFd();
+        ~EventSignal();
+
+    private:
+        int _fd;
+        mutex _lock;
+        condition_variable _condition;
+        uint64_t _generation;
+        uint64_t _consumedGeneration;
+    };
+
+    class EventReactor
+    {
+    public:
+        EventReactor();
+        uint AddReader(int fd, function<void()> callback);
+        uint AddSignal(EventSignal& signal, function<void()> callback);
+        uint AddTimer(uint intervalUs, function<void()> callback, bool repeat = true);
+        void Remove(uint key);
+        void Run();
+        bool RunOnce(int timeoutMs = -1);
+        void Stop();
+        bool IsRunning();
+        ~EventReactor();
+
+    private:
+        enum HandlerType
+        {
+            Reader,
+            Signal,
+            Timer
+        };
+        struct Handler
+        {
+            HandlerType type;
+            int fd;
+            function<void()> callback;
+        };
+        int _epoll;
+        bool _isRunning;
+        uint _nextKey;
+        EventSignal _stopSignal;
+        map<uint, Handler> _handlers;
+        SmartLock _handlersLock;
+        uint AddHandler(HandlerType type, int fd, function<void()> callback);
+    };
+
+    class Backoff
+    {
+    public:
+        Backoff(int initialMs, int maxMs);
+        int NextDelayMs();
+        void Reset();
+
+    private:
+        int _initialMs;
+        int _maxMs;
+        int _attempt;
+        mt19937 _rng;
+    };
+
+    enum PriorityClass
+    {
+        LowPriority = 0,
+        NormalPriority = 1,
+        HighPriority = 2
+    };
+
+    class WorkerGroup
+    {
+    public:
+        WorkerGroup(string name, PriorityClass priority);
+        string Name;
+        PriorityClass Priority;
+        future<void> Submit(function<void()> task);
+        int GetWorkerCount();
+        void Configure(ThreadConfig config);
+        void Shutdown();
+        ~WorkerGroup();
+
+    private:
+        ThreadConfig _config;
+        vector<pid_t> _workerThreadIds;
+        mutex _tasksLock;
+        condition_variable _tasksCondition;
+        queue<packaged_task<void()>> _tasks;
+        vector<thread> _workers;
+        int _idleWorkers;
+        bool _isRunning;
+        void RunWorker(int workerNum);
+    };
+
+    class StealingPool
+    {
+    public:
+        StealingPool(string name, PriorityClass priority, int numWorkers);
+        void ParallelFor(int start, int end, function<void(int, int)> body);
+        int GetWorkerCount();
+        void Configure(ThreadConfig config);
+        static int GetCurrentWorker();
+        ~StealingPool();
+
+    private:
+        struct ChunkGroup
+        {
+            atomic<int> remaining;
+            EventSignal doneSignal;
+        };
+        struct Chunk
+        {
+            int start;
+            int end;
+            function<void(int, int)>* body;
+            shared_ptr<ChunkGroup> group;
+        };
+        struct WorkerQueue
+        {
+            mutex lock;
+            deque<Chunk> chunks;
+        };
+        string _name;
+        PriorityClass _priority;
+        ThreadConfig _config;
+        vector<pid_t> _workerThreadIds;
+        mutex _configLock;
+        vector<thread> _workers;
+        vector<WorkerQueue*> _queues;
+        mutex _sleepLock;
+        condition_variable _sleepCondition;
+        atomic<int> _queuedChunks;
+        bool _isRunning;
+        void RunWorker(int workerNum);
+        bool TryRunChunk(int workerNum);
+        static void RunChunk(Chunk& chunk);
+    };
+
+    class Executor
+    {
+    public:
+        static Executor& Instance();
+        void AddGroup(string name, PriorityClass priority);
+        WorkerGroup& GetGroup(string name);
+        void ConfigureGroup(string name, ThreadConfig config);
+        future<void> Submit(string groupName, function<void()> task);
+        void ParallelFor(int start, int end, function<void(int, int)> body);
+        StealingPool& GetComputePool();
+
+    private:
+        Executor();
+        map<string, WorkerGroup*> _groups;
+        mutex _groupsLock;
+        StealingPool* _computePool;
+    };
+
+    struct NamedThread
+    {
+        string name;
+        pid_t threadId;
+        vector<unsigned long> coreSamples;
+    };
+
+    class ThreadRegistry
+    {
+    public:
+        static ThreadRegistry& Instance();
+        void Register(string name, pid_t threadId);
+        void Unregister(pid_t threadId);
+        void Sample();
+        string BuildCoreReport();
+
+    private:
+        ThreadRegistry();
+        map<pid_t, NamedThread> _threads;
+        vector<NamedThread> _finishedThreads;
+        mutex _threadsLock;
+        static int ReadLastCore(pid_t threadId);
+    };
+
+    class Counter
+    {
+    public:
+        Counter();
+        void Add(uint64_t amount = 1);
+        uint64_t Get();
+
+    private:
+        atomic<uint64_t> _value;
+    };
+
+    class Gauge
+    {
+    public:
+        Gauge();
+        void Set(double value);
+        double Get();
+
+    private:
+        atomic<double> _value;
+    };
+
+    struct HistogramSummary
+    {
+        uint64_t count;
+        double mean;
+        uint64_t p50;
+        uint64_t p90;
+        uint64_t p99;
+        uint64_t max;
+    };
+
+    class LatencyHistogram
+    {
+    public:
+        LatencyHistogram();
+        void Record(uint64_t value);
+        HistogramSummary Summarize();
+
+    private:
+        atomic<uint64_t> _buckets[(HISTOGRAM_MAGNITUDES + 1) << HISTOGRAM_SUB_BUCKET_BITS];
+        atomic<uint64_t> _count;
+        atomic<uint64_t> _sum;
+        atomic<uint64_t> _max;
+        static int GetBucket(uint64_t value);
+        static uint64_t GetBucketValue(int bucket);
+    };
+
+    class LatencyTimer
+    {
+    public:
+        LatencyTimer(LatencyHistogram& histogram);
+        uint64_t Stop();
+        ~LatencyTimer();
+
+    private:
+        LatencyHistogram* _histogram;
+        chrono::steady_clock::time_point _start;
+        bool _isStopped;
+    };
+
+    class MetricsRegistry
+    {
+    public:
+        static MetricsRegistry& Instance();
+        Counter& GetCounter(string name);
+        Gauge& GetGauge(string name);
+        LatencyHistogram& GetHistogram(string name);
+        string BuildSnapshot();
+        void StartReporting(string path, int intervalMs);
+        void StopReporting();
+
+    private:
+        MetricsRegistry();
+        map<string, Counter*> _counters;
+        map<string, Gauge*> _gauges;
+        map<string, LatencyHistogram*> _histograms;
+        mutex _metricsLock;
+        bool _isReporting;
+        EventSignal _stopSignal;
+        future<void> _reportFuture;
+        void Report(string path, int intervalMs);
+    };
+
+    struct TraceEvent
+    {
+        const char* name;
+        uint64_t startUs;
+        uint64_t durationUs;
+        int64_t frameIndex;
+    };
+
+    struct TraceBuffer
+    {
+        pid_t threadId;
+        string threadName;
+        mutex lock;
+        vector<TraceEvent> events;
+    };
+
+    class Tracer
+    {
+    public:
+        static Tracer& Instance();
+        void Start();
+        void Stop();
+        bool IsTracing();
+        void Record(const char* name, uint64_t startUs, uint64_t endUs, int64_t frameIndex);
+        void WriteChromeTrace(string fileName);
+        static uint64_t NowUs();
+        static int64_t GetCurrentFrame();
+        static void SetCurrentFrame(int64_t frameIndex);
+
+    private:
+        Tracer();
+        atomic<bool> _isTracing;
+        vector<TraceBuffer*> _buffers;
+        mutex _buffersLock;
+        TraceBuffer* GetThreadBuffer();
+    };
+
+    class TraceSpan
+    {
+    public:
+        TraceSpan(const char* name);
+        TraceSpan(const char* name, int64_t frameIndex);
+        ~TraceSpan();
+
+    private:
+        const char* _name;
+        int64_t _frameIndex;
+        uint64_t _startUs;
+        bool _isTracing;
+    };
+
+    class TraceFrameScope
+    {
+    public:
+        TraceFrameScope(int64_t frameIndex);
+        ~TraceFrameScope();
+
+    private:
+        int64_t _previousFrame;
+    };
+
     enum LogFlag
     {
         Error = 0b1,
@@ -42,4 +431,8 @@ namespace tsw::utilities
 }
 
 void ConfigureLog(uint flags);
+pid_t InitializeWorkerThread(string threadName, tsw::utilities::PriorityClass priority, ThreadConfig config);
+void ApplyThreadSettings(pid_t threadId, string threadName, tsw::utilities::PriorityClass priority, ThreadConfig config);
+void FinishWorkerThread(pid_t threadId);
 void Log(string s, uint flags);
+int64_t GetMonotonicTimeUs();
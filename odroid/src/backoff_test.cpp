@@ -0,0 +1,24 @@
+#include "utilities.hpp"
+#include <iostream>
+
+using namespace tsw::utilities;
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    // Same numbers startup uses. A device that stays missing keeps asking long after the delay tops out.
+    Backoff backoff(STARTUP_BACKOFF_INITIAL_MS, STARTUP_BACKOFF_MAX_MS);
+    int failures = 0;
+    for(int i = 0; i < 40; i++)
+    {
+        int delayMs = backoff.NextDelayMs();
+        cout << "Attempt " << i << ": " << delayMs << "ms" << endl;
+        if(delayMs < 0 || delayMs > STARTUP_BACKOFF_MAX_MS)
+        {
+            cout << "Delay out of [0, " << STARTUP_BACKOFF_MAX_MS << "]" << endl;
+            failures++;
+        }
+    }
+
+    return failures > 0 ? 1 : 0;
+}
@@ -0,0 +1,353 @@
+#include "imaging.hpp"
+#include "io.hpp"
+#include "utilities.hpp"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <random>
+#include <algorithm>
+#include <sys/utsname.h>
+
+#define BENCHMARK_MIN_BATCHES 5
+#define BENCHMARK_MAX_BATCHES 1000
+#define BENCHMARK_MIN_TIME_US 200000
+
+// Recorder batches are a fixed size, every frame in them has to be encoded before the next one.
+#define BENCHMARK_RECORDER_FRAMES 100
+
+using namespace tsw::imaging;
+using namespace tsw::io;
+using namespace tsw::utilities;
+using namespace std;
+
+string _filter;
+string _tag;
+string _machine;
+string _host;
+
+// Keeps the compiler from deciding our results are unused and throwing the work away.
+template<typename T> void KeepAlive(T& value)
+{
+    asm volatile("" : : "r"(&value) : "memory");
+}
+
+bool ShouldRun(string name)
+{
+    return _filter.empty() || name.find(_filter) != string::npos;
+}
+
+void Report(string name, string params, vector<double>& batchNsPerOp, size_t opsPerBatch)
+{
+    sort(batchNsPerOp.begin(), batchNsPerOp.end());
+    size_t n = batchNsPerOp.size();
+
+    // One json object per line, so results from different commits/machines can just be concatenated.
+    cout << "{\"benchmark\":\"" << name << "\",\"params\":{" << params << "}"
+        << ",\"machine\":\"" << _machine << "\",\"host\":\"" << _host << "\",\"tag\":\"" << _tag << "\""
+        << ",\"batches\":" << n << ",\"ops_per_batch\":" << opsPerBatch
+        << ",\"ns_per_op\":{\"min\":" << batchNsPerOp[0] << ",\"p50\":" << batchNsPerOp[n / 2]
+        << ",\"p90\":" << batchNsPerOp[n * 9 / 10] << ",\"max\":" << batchNsPerOp[n - 1] << "}}" << endl;
+}
+
+template<typename T> void RunBenchmark(string name, string params, size_t opsPerBatch, T op)
+{
+    if(!ShouldRun(name))
+    {
+        return;
+    }
+
+    // One batch to warm the caches up, that one does not count.
+    for(size_t i = 0; i < opsPerBatch; i++)
+    {
+        op();
+    }
+
+    vector<double> batchNsPerOp;
+    int64_t startUs = GetMonotonicTimeUs();
+    while(batchNsPerOp.size() < BENCHMARK_MAX_BATCHES && (batchNsPerOp.size() < BENCHMARK_MIN_BATCHES || GetMonotonicTimeUs() - startUs < BENCHMARK_MIN_TIME_US))
+    {
+        chrono::steady_clock::time_point batchStart = chrono::steady_clock::now();
+        for(size_t i = 0; i < opsPerBatch; i++)
+        {
+            op();
+        }
+        chrono::steady_clock::time_point batchEnd = chrono::steady_clock::now();
+        batchNsPerOp.push_back(chrono::duration<double, nano>(batchEnd - batchStart).count() / opsPerBatch);
+    }
+
+    Report(name, params, batchNsPerOp, opsPerBatch);
+}
+
+vector<OfficerInferenceBox> MakeOfficerBoxes(mt19937& rng, int count, int size, int frameWidth, int frameHeight)
+{
+    uniform_int_distribution<int> xDist(0, frameWidth - size - 1);
+    uniform_int_distribution<int> yDist(0, frameHeight - size - 1);
+    uniform_real_distribution<float> confidenceDist(0.3, 1);
+    vector<OfficerInferenceBox> boxes;
+    for(int i = 0; i < count; i++)
+    {
+        OfficerInferenceBox box;
+        box.topLeftX = xDist(rng);
+        box.topLeftY = yDist(rng);
+        box.bottomRightX = box.topLeftX + size;
+        box.bottomRightY = box.topLeftY + size;
+        box.confidence = confidenceDist(rng);
+        boxes.push_back(box);
+    }
+
+    return boxes;
+}
+
+vector<InferenceBoundingBox> MakeRawBoxes(mt19937& rng, int count, int frameWidth, int frameHeight)
+{
+    // Flir likes to hand us coordinates outside the frame, so make sure we get some of those too.
+    uniform_int_distribution<int> xDist(-50, frameWidth + 50);
+    uniform_int_distribution<int> yDist(-50, frameHeight + 50);
+    uniform_int_distribution<int> classDist(0, 2);
+    uniform_real_distribution<float> confidenceDist(0, 1);
+    vector<InferenceBoundingBox> boxes;
+    for(int i = 0; i < count; i++)
+    {
+        InferenceBoundingBox box;
+        box.classId = classDist(rng);
+        box.confidence = confidenceDist(rng);
+        box.rect.topLeftXCoord = xDist(rng);
+        box.rect.topLeftYCoord = yDist(rng);
+        box.rect.bottomRightXCoord = box.rect.topLeftXCoord + 100;
+        box.rect.bottomRightYCoord = box.rect.topLeftYCoord + 200;
+        boxes.push_back(box);
+    }
+
+    return boxes;
+}
+
+void BenchmarkLocator()
+{
+    // Noise is a decent stand in for the color filter, some of every box lands in the range.
+    int frameWidth = 1440;
+    int frameHeight = 1080;
+    Mat frame(frameHeight, frameWidth, CV_8UC3);
+    RNG cvRng(1);
+    cvRng.fill(frame, RNG::UNIFORM, 0, 256);
+
+    SmartOfficerLocator locator(0);
+    locator.MinHSV = Scalar(0, 100, 100);
+    locator.MaxHSV = Scalar(30, 255, 255);
+    locator.OfficerThreshold = 0.15;
+    locator.ConfidenceThreshold = 0.5;
+
+    mt19937 rng(1);
+    for(int count : { 1, 4, 16 })
+    {
+        for(int size : { 32, 128, 512 })
+        {
+            vector<OfficerInferenceBox> boxes = MakeOfficerBoxes(rng, count, size, frameWidth, frameHeight);
+            string params = "\"boxes\":" + to_string(count) + ",\"size\":" + to_string(size);
+
+            // Cold is everybody new every frame, warm is the same people as last frame so the tracks skip the color check.
+            RunBenchmark("locator.desired_box_cold", params, 10, [&]()
+            {
+                locator.Tracks.Reset();
+                OfficerInferenceBox* bestBox = locator.GetDesiredOfficerBox(boxes, frame);
+                KeepAlive(bestBox);
+                delete bestBox;
+            });
+
+            RunBenchmark("locator.desired_box_warm", params, 10, [&]()
+            {
+                OfficerInferenceBox* bestBox = locator.GetDesiredOfficerBox(boxes, frame);
+                KeepAlive(bestBox);
+                delete bestBox;
+            });
+        }
+    }
+
+    for(int count : { 8, 64 })
+    {
+        vector<InferenceBoundingBox> rawBoxes = MakeRawBoxes(rng, count, frameWidth, frameHeight);
+        RunBenchmark("locator.locations", "\"boxes\":" + to_string(count), 1000, [&]()
+        {
+            vector<OfficerInferenceBox> boxes = locator.GetOfficerLocations(rawBoxes, frameWidth, frameHeight);
+            KeepAlive(boxes);
+        });
+    }
+}
+
+void BenchmarkSerialCodec()
+{
+    for(int argBytes : { 0, 3, 7 })
+    {
+        vector<unsigned char> args(argBytes, 0x5a);
+        RunBenchmark("serial.encode", "\"args\":" + to_string(argBytes), 10000, [&]()
+        {
+            vector<unsigned char> encoded = DeviceMessageParser::Encode(Motors, RelativeMoveAsynchronous, args);
+            KeepAlive(encoded);
+        });
+
+        vector<unsigned char> encoded = DeviceMessageParser::Encode(Motors, RelativeMoveAsynchronous, args);
+        DeviceMessageParser parser;
+        RunBenchmark("serial.parse", "\"args\":" + to_string(argBytes), 10000, [&]()
+        {
+            DeviceMessage message;
+            for(unsigned char b : encoded)
+            {
+                parser.Push(b, &message);
+            }
+            KeepAlive(message);
+        });
+    }
+
+    for(int numBytes : { 1, 8, 64 })
+    {
+        vector<unsigned char> bytes(numBytes, 0xa5);
+        RunBenchmark("serial.to_hex", "\"bytes\":" + to_string(numBytes), 1000, [&]()
+        {
+            string hex = SerialPort::ToHex(bytes.data(), numBytes);
+            KeepAlive(hex);
+        });
+    }
+}
+
+void BenchmarkLog()
+{
+    // With the flag off this is what every disabled log line in the hot paths costs us.
+    ConfigureLog(0);
+    RunBenchmark("log", "\"enabled\":false", 10000, []()
+    {
+        Log("Frame # 12345 acquired", Frames);
+    });
+
+    // Send the enabled ones to nowhere so we measure the formatting and not the terminal.
+    ofstream devNull("/dev/null");
+    streambuf* coutBuffer = cout.rdbuf(devNull.rdbuf());
+    ConfigureLog(Frames);
+    RunBenchmark("log", "\"enabled\":true", 1000, []()
+    {
+        Log("Frame # 12345 acquired", Frames);
+    });
+    cout.rdbuf(coutBuffer);
+    ConfigureLog(0);
+}
+
+void BenchmarkSmartLock()
+{
+    if(!ShouldRun("smart_lock"))
+    {
+        return;
+    }
+
+    int opsPerThread = 100000;
+    for(int numThreads : { 1, 2, 4, 8 })
+    {
+        SmartLock lock("BNC");
+        vector<double> batchNsPerOp;
+        for(int batch = 0; batch < BENCHMARK_MIN_BATCHES; batch++)
+        {
+            // Everybody starts hammering at the same time.
+            atomic<bool> go(false);
+            vector<thread> threads;
+            for(int t = 0; t < numThreads; t++)
+            {
+                threads.push_back(thread([&]()
+                {
+                    while(!go)
+                    {
+                        this_thread::yield();
+                    }
+
+                    for(int i = 0; i < opsPerThread; i++)
+                    {
+                        lock.Lock("Benchmark");
+                        lock.Unlock("Benchmark");
+                    }
+                }));
+            }
+
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            go = true;
+            for(thread& t : threads)
+            {
+                t.join();
+            }
+            chrono::steady_clock::time_point end = chrono::steady_clock::now();
+            batchNsPerOp.push_back(chrono::duration<double, nano>(end - start).count() / (opsPerThread * numThreads));
+        }
+
+        Report("smart_lock", "\"threads\":" + to_string(numThreads), batchNsPerOp, opsPerThread * numThreads);
+    }
+}
+
+void BenchmarkRecorder()
+{
+    if(!ShouldRun("recorder.add_frame") && !ShouldRun("recorder.encode"))
+    {
+        return;
+    }
+
+    // Every frame handed off gets encoded eventually, so these run a fixed number of frames instead of for a set time.
+    // Each batch gets its own recording, and the encoder catches up outside of the timing.
+    Size frameSize(640, 480);
+    Mat frame(frameSize, CV_8UC3, Scalar(20, 40, 60));
+    string params = "\"width\":640,\"height\":480";
+    vector<double> addNsPerOp;
+    vector<double> encodeNsPerOp;
+    for(int batch = 0; batch < BENCHMARK_MIN_BATCHES; batch++)
+    {
+        Recorder recorder(frameSize, 30);
+        recorder.Name = "benchmark.recorder";
+        recorder.StartRecording("benchmark_recorder.avi");
+
+        // The hand off is what the acquisition thread pays per frame.
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for(int i = 0; i < BENCHMARK_RECORDER_FRAMES; i++)
+        {
+            recorder.AddFrame(frame, i);
+        }
+        chrono::steady_clock::time_point added = chrono::steady_clock::now();
+
+        // Stopping waits for the encoder to get through the rest, so this is how fast it can keep up.
+        recorder.StopRecording();
+        chrono::steady_clock::time_point encoded = chrono::steady_clock::now();
+        addNsPerOp.push_back(chrono::duration<double, nano>(added - start).count() / BENCHMARK_RECORDER_FRAMES);
+        encodeNsPerOp.push_back(chrono::duration<double, nano>(encoded - start).count() / BENCHMARK_RECORDER_FRAMES);
+    }
+
+    remove("benchmark_recorder.avi");
+    if(ShouldRun("recorder.add_frame"))
+    {
+        Report("recorder.add_frame", params, addNsPerOp, BENCHMARK_RECORDER_FRAMES);
+    }
+
+    if(ShouldRun("recorder.encode"))
+    {
+        Report("recorder.encode", params, encodeNsPerOp, BENCHMARK_RECORDER_FRAMES);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if(argc > 3)
+    {
+        cout << "Usage: benchmark [name_filter] [tag]" << endl;
+        return 1;
+    }
+
+    _filter = argc > 1 ? argv[1] : "";
+    _tag = argc > 2 ? argv[2] : "";
+
+    // Tag every result with where it came from so odroid and x86 runs can sit in the same file.
+    utsname name;
+    uname(&name);
+    _machine = name.machine;
+    _host = name.nodename;
+
+    // Nothing we are measuring should be logging unless we ask it to.
+    ConfigureLog(0);
+
+    BenchmarkLocator();
+    BenchmarkSerialCodec();
+    BenchmarkLog();
+    BenchmarkSmartLock();
+    BenchmarkRecorder();
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include "detections.hpp"
+#include <iostream>
+
+using namespace tsw::detections;
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    if(argc != 2)
+    {
+        cout << "Usage: detection_dump <detection_file>" << endl;
+        return 1;
+    }
+
+    DetectionReader reader(argv[1]);
+    DetectionFileHeader header = reader.GetHeader();
+    cerr << "Frames: " << reader.GetFrameCount() << " Size: " << header.frameWidth << " X " << header.frameHeight << " FPS: " << header.fps << endl;
+
+    // One line per frame so this can go straight into a spreadsheet.
+    cout << "frame,timestamp_us,boxes,stale,slewing,guided,found,should_move,region,movement_x,movement_y,chosen_confidence,command,command_h,command_v" << endl;
+    for(size_t i = 0; i < reader.GetFrameCount(); i++)
+    {
+        DetectionFrame frame = reader.GetFrame(i);
+        const DetectionFrameRecord* r = &frame.record;
+        cout << r->frameIndex << ',' << r->timestampUs << ',' << r->boxCount << ','
+            << (bool)(r->flags & DETECTION_FLAG_STALE) << ','
+            << (bool)(r->flags & DETECTION_FLAG_SLEWING) << ','
+            << (bool)(r->flags & DETECTION_FLAG_GUIDED) << ','
+            << (bool)(r->flags & DETECTION_FLAG_FOUND_OFFICER) << ','
+            << (bool)(r->flags & DETECTION_FLAG_SHOULD_MOVE) << ','
+            << (int)r->region << ',' << r->movementX << ',' << r->movementY << ',';
+
+        if(r->flags & DETECTION_FLAG_HAS_CHOSEN_BOX)
+        {
+            cout << r->chosenBox.confidence;
+        }
+        cout << ',';
+
+        if(r->flags & DETECTION_FLAG_COMMAND_ISSUED)
+        {
+            cout << (int)r->commandAction << ',' << r->commandHorizontal << ',' << r->commandVertical;
+        }
+        else
+        {
+            cout << ",,";
+        }
+        cout << endl;
+    }
+
+    return 0;
+}
@@ -0,0 +1,107 @@
+#include "detections.hpp"
+#include <cstring>
+#include <cstddef>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+using namespace tsw::detections;
+
+DetectionReader::DetectionReader(string fileName)
+{
+    _file = open(fileName.c_str(), O_RDONLY);
+    if(_file < 0)
+    {
+        throw runtime_error("Could not open detection file " + fileName);
+    }
+
+    struct stat fileStats;
+    if(fstat(_file, &fileStats) != 0 || fileStats.st_size < (off_t)sizeof(DetectionFileHeader))
+    {
+        close(_file);
+        throw runtime_error("Detection file " + fileName + " is too small to be valid.");
+    }
+
+    // Map the whole thing in, the kernel will page it in as we go.
+    _size = fileStats.st_size;
+    void* mapped = mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, _file, 0);
+    if(mapped == MAP_FAILED)
+    {
+        close(_file);
+        throw runtime_error("Could not map detection file " + fileName);
+    }
+
+    // We are almost always going to read this front to back.
+    madvise(mapped, _size, MADV_SEQUENTIAL);
+    _data = (const unsigned char*)mapped;
+
+    DetectionFileHeader header = GetHeader();
+    if(memcmp(header.magic, DETECTIONS_MAGIC, sizeof(header.magic)) != 0 || header.version != DETECTIONS_VERSION)
+    {
+        munmap(mapped, _size);
+        close(_file);
+        throw runtime_error("File " + fileName + " is not a supported detection file.");
+    }
+
+    IndexFrames();
+}
+
+DetectionFileHeader DetectionReader::GetHeader()
+{
+    DetectionFileHeader header;
+    memcpy(&header, _data, sizeof(header));
+    return header;
+}
+
+size_t DetectionReader::GetFrameCount()
+{
+    return _frameOffsets.size();
+}
+
+DetectionFrame DetectionReader::GetFrame(size_t frameNum)
+{
+    if(frameNum >= _frameOffsets.size())
+    {
+        throw out_of_range("Frame " + to_string(frameNum) + " does not exist in detection file.");
+    }
+
+    // The records are packed, so nothing in the mapped file is aligned. Copy it all out instead of pointing into it.
+    DetectionFrame frame;
+    const unsigned char* recordData = _data + _frameOffsets[frameNum];
+    memcpy(&frame.record, recordData, sizeof(DetectionFrameRecord));
+    frame.boxes.resize(frame.record.boxCount);
+    if(frame.record.boxCount > 0)
+    {
+        memcpy(frame.boxes.data(), recordData + sizeof(DetectionFrameRecord), frame.record.boxCount * sizeof(OfficerInferenceBox));
+    }
+    return frame;
+}
+
+void DetectionReader::IndexFrames()
+{
+    // Each record is variable length, so we walk them once to find where they all start.
+    size_t offset = GetHeader().headerSize;
+    while(offset + sizeof(DetectionFrameRecord) <= _size)
+    {
+        uint16_t boxCount;
+        memcpy(&boxCount, _data + offset + offsetof(DetectionFrameRecord, boxCount), sizeof(boxCount));
+        size_t recordSize = sizeof(DetectionFrameRecord) + boxCount * sizeof(OfficerInferenceBox);
+
+        // If we lost power mid-write, the last frame will be cut off. Just ignore it.
+        if(offset + recordSize > _size)
+        {
+            break;
+        }
+
+        _frameOffsets.push_back(offset);
+        offset += recordSize;
+    }
+}
+
+DetectionReader::~DetectionReader()
+{
+    munmap((void*)_data, _size);
+    close(_file);
+}
@@ -0,0 +1,64 @@
+#include "detections.hpp"
+#include "utilities.hpp"
+#include <cstring>
+
+using namespace tsw::detections;
+using namespace tsw::utilities;
+
+DetectionWriter::DetectionWriter() { }
+
+void DetectionWriter::Open(string fileName, int frameWidth, int frameHeight, double fps)
+{
+    if(IsOpen())
+    {
+        Close();
+    }
+
+    // A big buffer means we only hit the disk every few hundred frames.
+    _file.rdbuf()->pubsetbuf(_fileBuffer, sizeof(_fileBuffer));
+    _file.open(fileName, ofstream::out | ofstream::binary | ofstream::trunc);
+    if(!_file.is_open())
+    {
+        throw runtime_error("Detection file " + fileName + " could not be opened.");
+    }
+
+    DetectionFileHeader header;
+    memcpy(header.magic, DETECTIONS_MAGIC, sizeof(header.magic));
+    header.version = DETECTIONS_VERSION;
+    header.headerSize = sizeof(DetectionFileHeader);
+    header.frameWidth = frameWidth;
+    header.frameHeight = frameHeight;
+    header.fps = fps;
+    _file.write((char*)&header, sizeof(header));
+    Log("Writing detections to " + fileName, Recording);
+}
+
+void DetectionWriter::Close()
+{
+    if(IsOpen())
+    {
+        _file.close();
+        Log("Detection file closed", Recording);
+    }
+}
+
+bool DetectionWriter::IsOpen()
+{
+    return _file.is_open();
+}
+
+void DetectionWriter::WriteFrame(DetectionFrameRecord record, vector<OfficerInferenceBox>& boxes)
+{
+    if(IsOpen())
+    {
+        // The boxes go right after the record so the reader can point straight at them.
+        record.boxCount = boxes.size();
+        _file.write((char*)&record, sizeof(record));
+        _file.write((char*)boxes.data(), boxes.size() * sizeof(OfficerInferenceBox));
+    }
+}
+
+DetectionWriter::~DetectionWriter()
+{
+    Close();
+}
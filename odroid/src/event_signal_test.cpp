@@ -0,0 +1,37 @@
+#include "utilities.hpp"
+#include <iostream>
+
+using namespace tsw::utilities;
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    // Two threads waiting on the same signal both have to see a single notify.
+    EventSignal signal;
+    atomic<int> woken(0);
+    auto waiter = [&]()
+    {
+        if(signal.Wait(2000))
+        {
+            woken++;
+        }
+    };
+
+    thread first(waiter);
+    thread second(waiter);
+
+    // Give them both a chance to actually be waiting.
+    this_thread::sleep_for(chrono::milliseconds(200));
+    signal.Notify();
+    first.join();
+    second.join();
+    cout << "Waiters woken: " << woken << " of 2" << endl;
+
+    // A notify with nobody around is still there for the next waiter, but only the one.
+    signal.Notify();
+    bool latched = signal.Wait(0);
+    bool consumed = !signal.Wait(0);
+    cout << "Latched: " << latched << " Consumed: " << consumed << endl;
+
+    return woken == 2 && latched && consumed ? 0 : 1;
+}
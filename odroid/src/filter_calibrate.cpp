@@ -17,6 +17,7 @@ using namespace tsw::io::settings;
 using namespace cv;
 
 bool isFiltering = false;
+EventSignal doneSignal;
 
 int lowH = 0, highH = MAX_H;
 int lowS = 0, highS = MAX_S;
@@ -73,6 +74,7 @@ void OnLiveFeedImageReceived(LiveFeedCallbackArgs args)
     if(key == 'q' || key == 27)
     {
         isFiltering = false;
+        doneSignal.Notify();
     }
 }
 
@@ -112,9 +114,10 @@ int main(int argc, char* argv[])
     isFiltering = true;
     camera.StartLiveFeed();
 
+    // The live feed callback will wake us up when they want to quit.
     while(isFiltering)
     {
-        usleep(100000);
+        doneSignal.Wait();
     }
 
     camera.UnregisterLiveFeedCallback(key);
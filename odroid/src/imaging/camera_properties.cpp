@@ -0,0 +1,189 @@
+#include "imaging.hpp"
+
+using namespace tsw::imaging;
+
+// Everything we touch on a regular basis. Anything else gets looked up the first time somebody asks for it.
+// Not every model has all of these (binning and the light source mostly), the missing ones just count as unavailable.
+const char* KnownCameraNodes[] = { "Width", "Height", "OffsetX", "OffsetY", "WidthMax", "HeightMax", "AcquisitionFrameRate",
+    "AcquisitionFrameRateEnable", "AcquisitionResultingFrameRate", "RgbTransformLightSource", "BinningHorizontal", "BinningVertical" };
+
+CameraProperties::CameraProperties()
+{
+    _nodeMap = nullptr;
+}
+
+void CameraProperties::Attach(INodeMap& nodeMap)
+{
+    // A new connection means new nodes, and whatever we knew about the old ones is gone.
+    lock_guard<mutex> lock(_lock);
+    _nodeMap = &nodeMap;
+    _nodes.clear();
+    _written.clear();
+    _applied.clear();
+    _read.clear();
+    for(const char* name : KnownCameraNodes)
+    {
+        FindNode(name);
+    }
+}
+
+bool CameraProperties::IsAvailable(string name)
+{
+    lock_guard<mutex> lock(_lock);
+    return _nodeMap && FindNode(name);
+}
+
+void CameraProperties::Forget()
+{
+    // Some writes move other values around on the camera, so the next look has to go to the camera.
+    lock_guard<mutex> lock(_lock);
+    _written.clear();
+    _applied.clear();
+    _read.clear();
+}
+
+void CameraProperties::Detach()
+{
+    lock_guard<mutex> lock(_lock);
+    _nodeMap = nullptr;
+    _nodes.clear();
+    _written.clear();
+    _applied.clear();
+    _read.clear();
+}
+
+int64_t CameraProperties::GetInt(string name)
+{
+    lock_guard<mutex> lock(_lock);
+    if(_applied.count(name))
+    {
+        return (int64_t)_applied[name];
+    }
+
+    if(!_read.count(name))
+    {
+        CIntegerPtr node = GetNode(name);
+        _read[name] = node->GetValue();
+    }
+
+    return (int64_t)_read[name];
+}
+
+int64_t CameraProperties::GetIncrement(string name)
+{
+    // Only asked for when the geometry changes, so no point remembering it.
+    lock_guard<mutex> lock(_lock);
+    CIntegerPtr node = GetNode(name);
+    return node->GetInc();
+}
+
+double CameraProperties::GetFloat(string name)
+{
+    lock_guard<mutex> lock(_lock);
+    if(_applied.count(name))
+    {
+        return _applied[name];
+    }
+
+    if(!_read.count(name))
+    {
+        CFloatPtr node = GetNode(name);
+        _read[name] = node->GetValue();
+    }
+
+    return _read[name];
+}
+
+void CameraProperties::SetInt(string name, int64_t value)
+{
+    lock_guard<mutex> lock(_lock);
+    if(!IsUnchanged(name, value))
+    {
+        CIntegerPtr node = GetNode(name);
+        node->SetValue(value);
+
+        // The camera rounds to its increments and clamps to its limits, so what it took isn't always what we asked for.
+        Remember(name, value, node->GetValue());
+    }
+}
+
+void CameraProperties::SetFloat(string name, double value)
+{
+    lock_guard<mutex> lock(_lock);
+    if(!IsUnchanged(name, value))
+    {
+        CFloatPtr node = GetNode(name);
+        node->SetValue(value);
+        Remember(name, value, node->GetValue());
+    }
+}
+
+void CameraProperties::SetBool(string name, bool value)
+{
+    lock_guard<mutex> lock(_lock);
+    if(!IsUnchanged(name, value))
+    {
+        CBooleanPtr node = GetNode(name);
+        node->SetValue(value);
+        Remember(name, value, node->GetValue());
+    }
+}
+
+void CameraProperties::SetEnum(string name, int64_t value)
+{
+    lock_guard<mutex> lock(_lock);
+    if(!IsUnchanged(name, value))
+    {
+        CEnumerationPtr node = GetNode(name);
+        node->SetIntValue(value);
+        Remember(name, value, node->GetIntValue());
+    }
+}
+
+INode* CameraProperties::GetNode(string name)
+{
+    if(!_nodeMap)
+    {
+        throw runtime_error("Camera property " + name + " asked for without a camera.");
+    }
+
+    INode* node = FindNode(name);
+    if(!node)
+    {
+        throw runtime_error("Camera does not have a " + name + " property.");
+    }
+
+    return node;
+}
+
+INode* CameraProperties::FindNode(string name)
+{
+    // Looking a node up by name walks the whole map, so only do it once per connection.
+    // That goes for the ones that aren't there too, they are remembered as null.
+    map<string, INode*>::iterator found = _nodes.find(name);
+    if(found != _nodes.end())
+    {
+        return found->second;
+    }
+
+    INode* node = _nodeMap->GetNode(name.c_str());
+    _nodes[name] = node;
+    return node;
+}
+
+bool CameraProperties::IsUnchanged(string name, double value)
+{
+    // Only what we wrote counts. Something we only read could have changed on its own.
+    map<string, double>::iterator written = _written.find(name);
+    return written != _written.end() && written->second == value;
+}
+
+void CameraProperties::Remember(string name, double requested, double applied)
+{
+    // What we asked for decides if the next write can be skipped, what the camera took is what everyone gets to read.
+    _written[name] = requested;
+    _applied[name] = applied;
+
+    // Plenty of the read only ones depend on the others (max sizes, resulting frame rate), so they have to be read again.
+    _read.clear();
+}
@@ -22,7 +22,7 @@ void DisplayWindow::Show()
     if(!IsShown())
     {
         _isShown = true;
-        _showFuture = async(launch::async, [this]()
+        _showFuture = Executor::Instance().Submit(DISPLAY_GROUP, [this]()
         {
             RunWindow();
         });
@@ -34,6 +34,7 @@ void DisplayWindow::Close()
     if(IsShown())
     {
         _isShown = false;
+        _frameSignal.Notify();
         _showFuture.wait();
     }
     
@@ -51,9 +52,10 @@ void DisplayWindow::RunWindow()
             _displayLock.Unlock("Showing frame");
         }
 
-        // Wait a bit before updating again.
-        // This also actually lets opencv keep the window up.
-        waitKey(1000 / _refreshRate);
+        // Sleep until there is a new frame, but not longer than the refresh period.
+        // Opencv still needs waitKey called every so often to keep the window up.
+        _frameSignal.Wait(1000 / _refreshRate);
+        waitKey(1);
     }
     destroyAllWindows();
 }
@@ -64,4 +66,5 @@ void DisplayWindow::Update(Mat currentFrame)
     _displayLock.Lock("Assigning new frame");
     _currentFrame = currentFrame;
     _displayLock.Unlock("Assigning new frame");
+    _frameSignal.Notify();
 }
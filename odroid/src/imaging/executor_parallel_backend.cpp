@@ -0,0 +1,40 @@
+#include "imaging.hpp"
+
+using namespace tsw::imaging;
+using namespace tsw::utilities;
+
+ExecutorParallelBackend::ExecutorParallelBackend(StealingPool& pool)
+{
+    _pool = &pool;
+}
+
+void ExecutorParallelBackend::parallel_for(int tasks, FN_parallel_for_body_cb_t bodyCallback, void* callbackData)
+{
+    // Opencv already split the work up into tasks, we just have to hand out the ranges.
+    _pool->ParallelFor(0, tasks, [bodyCallback, callbackData](int start, int end)
+    {
+        bodyCallback(start, end, callbackData);
+    });
+}
+
+int ExecutorParallelBackend::getThreadNum() const
+{
+    // The thread that called parallel_for is 0, the pool workers come after it.
+    return StealingPool::GetCurrentWorker() + 1;
+}
+
+int ExecutorParallelBackend::getNumThreads() const
+{
+    return _pool->GetWorkerCount() + 1;
+}
+
+int ExecutorParallelBackend::setNumThreads(int)
+{
+    // The pool is sized for the whole system, so whatever opencv asks for, it gets what is already there.
+    return getNumThreads();
+}
+
+const char* ExecutorParallelBackend::getName() const
+{
+    return "tsw";
+}
@@ -41,12 +41,31 @@ FlirCamera::FlirCamera(int bufferCount)
     _userFrameWidth = nullptr;
     _userFrameHeight = nullptr;
     _userFilter = nullptr;
+    _hasClockOffset = false;
+    _clockOffsetUs = 0;
+    _lastClockSyncUs = 0;
+    _isInStandby = false;
+    _standbyFrameRate = 0;
+    _isConfiguring = false;
+    _isConnected = false;
+    _shouldBeConnected = false;
+    _isSupervising = false;
+    _connectionCallbacksLock.Name = "CCB";
+
+    // Whole frame, full detail, same as always.
+    _readout.binning = 1;
+    _readout.crop = 1;
+    _activeReadout = _readout;
+    _isReadoutPending = false;
+    _nextConnectionKey = 1;
 }
 
 FlirCamera::~FlirCamera()
 {
-    // Make sure the live feed is not going.
+    // Make sure the live feed is not going, and nobody is trying to bring the camera back.
     StopLiveFeed();
+    StopSupervisor();
+    WaitForClockSync();
 
     _system->ReleaseInstance();
     delete _userFilter;
@@ -60,7 +79,7 @@ vector<string> FlirCamera::FindDevices()
     _system->UpdateCameras();
     CameraList cameras = _system->GetCameras();
     vector<string> serials;
-    for(int i = 0; i < cameras.GetSize(); i++)
+    for(unsigned int i = 0; i < cameras.GetSize(); i++)
     {
         serials.push_back(cameras.GetByIndex(i)->DeviceID.GetValue().c_str());
     }
@@ -76,6 +95,21 @@ void FlirCamera::Connect(string serialNumber)
     }
 
     _shouldBeConnected = true;
+    SetConnected(true);
+
+    // Anything that got set before we had a camera goes out now.
+    {
+        lock_guard<mutex> lock(_configurationLock);
+        ApplyConfiguration();
+    }
+
+    // From here on the supervisor is the one that deals with the camera going away.
+    StartSupervisor();
+}
+
+bool FlirCamera::IsConnected()
+{
+    return _isConnected;
 }
 
 double FlirCamera::GetDeviceTemperature()
@@ -87,36 +121,184 @@ double FlirCamera::GetDeviceTemperature()
 double FlirCamera::GetFrameRate()
 {
     EnsureConnectionNotLost();
-    return _camera->AcquisitionResultingFrameRate.GetValue();
+    return _properties.GetFloat("AcquisitionResultingFrameRate");
 }
 
 int FlirCamera::GetFrameHeight()
 {
     EnsureConnectionNotLost();
-    return _camera->Height.GetValue();
+    return _properties.GetInt("Height");
 }
 
 int FlirCamera::GetFrameWidth()
 {
     EnsureConnectionNotLost();
-    return _camera->Width.GetValue();
+    return _properties.GetInt("Width");
 }
 
 void FlirCamera::SetFrameRate(double hertz)
 {
-    EnsureConnectionNotLost();
-    _camera->AcquisitionFrameRateEnable = true;
-    _camera->AcquisitionFrameRate = hertz;
+    lock_guard<mutex> lock(_configurationLock);
     delete _userFrameRate;
     _userFrameRate = new double(hertz);
+    if(!_isConfiguring)
+    {
+        ApplyConfiguration();
+    }
 }
 
 void FlirCamera::SetFilter(RgbTransformLightSourceEnums filter)
 {
-    EnsureConnectionNotLost();
-    _camera->RgbTransformLightSource = filter;
+    lock_guard<mutex> lock(_configurationLock);
     delete _userFilter;
     _userFilter = new RgbTransformLightSourceEnums(filter);
+    if(!_isConfiguring)
+    {
+        ApplyConfiguration();
+    }
+}
+
+void FlirCamera::BeginConfiguration()
+{
+    // Hold off on sending anything until it is all set, so it can go out in one go.
+    lock_guard<mutex> lock(_configurationLock);
+    _isConfiguring = true;
+}
+
+void FlirCamera::CommitConfiguration()
+{
+    lock_guard<mutex> lock(_configurationLock);
+    _isConfiguring = false;
+    ApplyConfiguration();
+}
+
+void FlirCamera::ApplyConfiguration()
+{
+    // If the camera is gone, the supervisor puts all of this back when it reconnects.
+    if(_isConnected)
+    {
+        WriteConfiguration();
+    }
+}
+
+void FlirCamera::WriteConfiguration()
+{
+    // Without binning the best we can do is the crop. The frames say what they really are, so everyone downstream still lines up.
+    if(_activeReadout.binning != 1 && !_properties.IsAvailable("BinningHorizontal"))
+    {
+        Log("Camera does not support binning, reading out at full resolution", Frames | tsw::utilities::Error);
+        _activeReadout.binning = 1;
+    }
+
+    // Binning changes what the max size is, so it has to go before the size.
+    if(_properties.IsAvailable("BinningHorizontal") && _activeReadout.binning != _properties.GetInt("BinningHorizontal"))
+    {
+        _properties.SetInt("BinningHorizontal", _activeReadout.binning);
+        _properties.SetInt("BinningVertical", _activeReadout.binning);
+
+        // The camera moved the size and offset around to fit, so what we last wrote doesn't mean anything anymore.
+        _properties.Forget();
+    }
+
+    // The max frame rate depends on the size, so the size has to go first.
+    bool isDefaultReadout = _activeReadout.binning == 1 && _activeReadout.crop == 1;
+    if(_userFrameWidth || !isDefaultReadout)
+    {
+        ApplyGeometry("Width", "OffsetX", "WidthMax", GetReadoutSize("Width", "WidthMax", _userFrameWidth));
+    }
+
+    if(_userFrameHeight || !isDefaultReadout)
+    {
+        ApplyGeometry("Height", "OffsetY", "HeightMax", GetReadoutSize("Height", "HeightMax", _userFrameHeight));
+    }
+
+    // Standby gets to keep its own rate until it is done.
+    if(_isInStandby)
+    {
+        _properties.SetBool("AcquisitionFrameRateEnable", true);
+        _properties.SetFloat("AcquisitionFrameRate", _standbyFrameRate);
+    }
+    else if(_userFrameRate)
+    {
+        _properties.SetBool("AcquisitionFrameRateEnable", true);
+        _properties.SetFloat("AcquisitionFrameRate", *_userFrameRate);
+    }
+
+    if(_userFilter)
+    {
+        if(_properties.IsAvailable("RgbTransformLightSource"))
+        {
+            _properties.SetEnum("RgbTransformLightSource", *_userFilter);
+        }
+        else
+        {
+            Log("Camera does not support a light source filter, ignoring it", Frames | tsw::utilities::Error);
+        }
+    }
+}
+
+int FlirCamera::GetReadoutSize(string size, string maxSize, int* userValue)
+{
+    // The user's size is in sensor pixels, but the max is already binned.
+    int maxValue = _properties.GetInt(maxSize);
+    double fullValue = userValue ? *userValue / (double)_activeReadout.binning : maxValue;
+
+    // The camera only takes sizes in steps, anything else gets thrown back at us.
+    int increment = max((int)_properties.GetIncrement(size), 1);
+    int value = (int)(fullValue * _activeReadout.crop) / increment * increment;
+    return max(increment, min(value, maxValue));
+}
+
+void FlirCamera::SetReadout(CameraReadout readout)
+{
+    lock_guard<mutex> lock(_configurationLock);
+    _readout = readout;
+    if(IsLiveFeedOn())
+    {
+        // The size can't change mid stream, so the live feed swaps it in between frames.
+        _isReadoutPending = true;
+    }
+    else
+    {
+        _activeReadout = readout;
+        if(!_isConfiguring)
+        {
+            ApplyConfiguration();
+        }
+    }
+}
+
+CameraReadout FlirCamera::GetReadout()
+{
+    lock_guard<mutex> lock(_configurationLock);
+    return _readout;
+}
+
+void FlirCamera::SwitchReadout()
+{
+    lock_guard<mutex> lock(_configurationLock);
+    _isReadoutPending = false;
+    _activeReadout = _readout;
+    Log("Switching camera readout to " + to_string(_activeReadout.binning) + "x binning, " + to_string(_activeReadout.crop) + " crop", Frames);
+    ApplyConfiguration();
+}
+
+void FlirCamera::ApplyGeometry(string size, string offset, string maxSize, int value)
+{
+    // The camera does not auto center the region of interest, so we have to do it manually.
+    // The library does not allow offset + size to exceed the max at any point.
+    // So growing moves the offset first, and shrinking changes the size first.
+    int centered = (_properties.GetInt(maxSize) - value) / 2;
+    if(value > _properties.GetInt(size))
+    {
+        _properties.SetInt(offset, centered);
+        _properties.SetInt(size, value);
+    }
+    else
+    {
+        _properties.SetInt(size, value);
+        _properties.SetInt(offset, centered);
+    }
 }
 
 void FlirCamera::StartLiveFeed()
@@ -126,7 +308,7 @@ void FlirCamera::StartLiveFeed()
     {
         Log("Starting camera live feed", Frames);
         _isLiveFeedOn = true;
-        _liveFeedFuture = async(launch::async, [this]()
+        _liveFeedFuture = Executor::Instance().Submit(ACQUISITION_GROUP, [this]()
         {
             RunLiveFeed();
         });
@@ -138,7 +320,12 @@ void FlirCamera::StopLiveFeed()
     if(IsLiveFeedOn())
     {
         Log("Stopping camera live feed", Frames);
-        _isLiveFeedOn = false;
+        {
+            // The feed might be sitting there waiting for the camera to come back.
+            lock_guard<mutex> lock(_connectionLock);
+            _isLiveFeedOn = false;
+        }
+        _connectionCondition.notify_all();
 
         // This will wait for the live feed thread to stop.
         _liveFeedFuture.wait();
@@ -150,6 +337,36 @@ bool FlirCamera::IsLiveFeedOn()
     return _isLiveFeedOn;
 }
 
+void FlirCamera::EnterStandby(double hertz)
+{
+    // Keep the stream going slow so exposure and gain stay settled, but nobody sees the frames.
+    Log("Putting camera in standby at " + to_string(hertz) + "fps", Frames);
+    {
+        lock_guard<mutex> lock(_configurationLock);
+        _standbyFrameRate = hertz;
+        _isInStandby = true;
+        ApplyConfiguration();
+    }
+    StartLiveFeed();
+}
+
+void FlirCamera::ExitStandby()
+{
+    if(IsInStandby())
+    {
+        // Same stream, just back up to the rate the user wants. No need to restart acquisition.
+        Log("Taking camera out of standby", Frames);
+        lock_guard<mutex> lock(_configurationLock);
+        _isInStandby = false;
+        ApplyConfiguration();
+    }
+}
+
+bool FlirCamera::IsInStandby()
+{
+    return _isInStandby;
+}
+
 uint FlirCamera::RegisterLiveFeedCallback(function<void(LiveFeedCallbackArgs)> callback)
 {
     _liveFeedLock.Lock("Register Callback");
@@ -175,12 +392,49 @@ void FlirCamera::UnregisterLiveFeedCallback(uint callbackKey)
     _liveFeedLock.Unlock("Unregister Callback");
 }
 
-void FlirCamera::OnLiveFeedImageReceived(ImagePtr image, uint imageIndex)
+uint FlirCamera::RegisterConnectionCallback(function<void(CameraConnectionState)> callback)
+{
+    _connectionCallbacksLock.Lock("Register Callback");
+    ConnectionCallback cb;
+    cb.callback = callback;
+    cb.callbackKey = _nextConnectionKey++;
+    _connectionCallbacks.push_back(cb);
+    _connectionCallbacksLock.Unlock("Register Callback");
+    return cb.callbackKey;
+}
+
+void FlirCamera::UnregisterConnectionCallback(uint callbackKey)
+{
+    _connectionCallbacksLock.Lock("Unregister Callback");
+    _connectionCallbacks.remove_if([callbackKey](ConnectionCallback cb)
+    {
+        return cb.callbackKey == callbackKey;
+    });
+    _connectionCallbacksLock.Unlock("Unregister Callback");
+}
+
+void FlirCamera::PublishConnectionState(CameraConnectionState state)
+{
+    Log(string("Camera ") + (state == CameraConnected ? "connected" : "lost") + ", letting everybody know", Frames);
+    _connectionCallbacksLock.Lock("Run Callback");
+    for(ConnectionCallback cb : _connectionCallbacks)
+    {
+        cb.callback(state);
+    }
+    _connectionCallbacksLock.Unlock("Run Callback");
+}
+
+void FlirCamera::OnLiveFeedImageReceived(ImagePtr image, uint imageIndex, FrameTiming timing)
 {
     Log("Frame # " + to_string(imageIndex) + " acquired", Frames);
+
+    // Anything traced from the callbacks belongs to this frame.
+    TraceFrameScope frameScope(imageIndex);
     LiveFeedCallbackArgs args;
     args.image = image;
     args.imageIndex = imageIndex;
+    args.timing = timing;
+    args.readout = _activeReadout;
 
     // We do not want to call any of the callbacks while one of them is being removed/added.
     Log("Starting live feed callbacks", Frames);
@@ -218,79 +472,247 @@ void FlirCamera::RunLiveFeed()
 {   
     EnsureConnectionNotLost();
 
+    // Anything asked for while we were stopped can just go out before we start.
+    if(_isReadoutPending)
+    {
+        SwitchReadout();
+    }
+
     // Begin acquireung camera frames.
     _camera->BeginAcquisition();
+    SyncClock();
+
+    // Look these up once, the loop below is hot.
+    MetricsRegistry& metrics = MetricsRegistry::Instance();
+    Counter& framesCounter = metrics.GetCounter("camera.frames");
+    Counter& droppedCounter = metrics.GetCounter("camera.dropped_frames");
+    Counter& errorsCounter = metrics.GetCounter("camera.grab_errors");
+    Counter& standbyCounter = metrics.GetCounter("camera.standby_frames");
+    LatencyHistogram& exposureHistogram = metrics.GetHistogram("latency.exposure_to_host_us");
+    LatencyHistogram& grabHistogram = metrics.GetHistogram("camera.grab_us");
+    LatencyHistogram& convertHistogram = metrics.GetHistogram("camera.convert_us");
+    LatencyHistogram& callbacksHistogram = metrics.GetHistogram("camera.callbacks_us");
+    LatencyHistogram& readoutHistogram = metrics.GetHistogram("camera.readout_switch_us");
+    Counter& readoutCounter = metrics.GetCounter("camera.readout_switches");
+    Gauge& frameRateGauge = metrics.GetGauge("camera.fps");
+    chrono::steady_clock::time_point lastFrameTime = chrono::steady_clock::now();
 
     // This will keep track of which frame we are on.
     uint imageIndex = 0;
+    uint64_t lastFrameId = 0;
+    bool hasLastFrameId = false;
     while(IsLiveFeedOn())
     {
         ImagePtr image;
         try
         {
+            // The size can't change while acquiring, so stop just long enough to swap it.
+            if(_isReadoutPending)
+            {
+                LatencyTimer readoutTimer(readoutHistogram);
+                _camera->EndAcquisition();
+                SwitchReadout();
+                _camera->BeginAcquisition();
+                readoutCounter.Add();
+                hasLastFrameId = false;
+            }
+
             // Grab an image from the camera
-            image = _camera->GetNextImage(1000);
+            // Standby can be slow enough that a second is not long enough to wait.
+            LatencyTimer grabTimer(grabHistogram);
+            TraceSpan grabSpan("Acquire", imageIndex);
+            uint timeoutMs = _isInStandby ? max(1000, (int)(2000 / _standbyFrameRate)) : 1000;
+            image = _camera->GetNextImage(timeoutMs);
         }
-        catch(Spinnaker::Exception e)
+        catch(const Spinnaker::Exception& e)
         {
             // Inform that we had trouble grabbing an image.
+            errorsCounter.Add();
+            hasLastFrameId = false;
             Log("Error thrown grabbing frame. Live feed will restart. " + string(e.what()), Frames | tsw::utilities::Error);
 
-            // Reset the camera.
+            // The camera may already be gone, so this is allowed to fail.
             Log("Stopping frame acquisition temporarily", Frames);
-            _camera->EndAcquisition();
-            PowerCycle();
-            
-            Log("Frame acquisition resuming", Frames);
-            _camera->BeginAcquisition();
+            try
+            {
+                _camera->EndAcquisition();
+            }
+            catch(const Spinnaker::Exception& e)
+            {
+                Log("Could not stop frame acquisition. " + string(e.what()), Frames);
+            }
+
+            // Getting the camera back is the supervisor's problem, we just wait for it.
+            if(!RecoverAcquisition())
+            {
+                // Somebody stopped the feed while we were waiting.
+                return;
+            }
 
             Log("Livefeed restarted successfully.", Frames);
             continue;
         }
+
+        // In standby nobody wants the frame, so don't bother converting it. Just give the buffer back.
+        if(_isInStandby)
+        {
+            image->Release();
+            standbyCounter.Add();
+            hasLastFrameId = false;
+            continue;
+        }
         
+        // Figure out when this frame was actually exposed, in our clock.
+        int64_t receivedUs = GetMonotonicTimeUs();
+        FrameTiming timing = GetFrameTiming(image, receivedUs);
+        if(timing.exposureUs >= 0 && receivedUs > timing.exposureUs)
+        {
+            exposureHistogram.Record(receivedUs - timing.exposureUs);
+        }
+
+        // The camera numbers every frame, so gaps mean the buffers overflowed and we lost some.
+        uint64_t frameId = image->GetFrameID();
+        if(hasLastFrameId && frameId > lastFrameId + 1)
+        {
+            droppedCounter.Add(frameId - lastFrameId - 1);
+        }
+        lastFrameId = frameId;
+        hasLastFrameId = true;
+
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        double frameSeconds = chrono::duration<double>(now - lastFrameTime).count();
+        lastFrameTime = now;
+        if(frameSeconds > 0)
+        {
+            frameRateGauge.Set(1 / frameSeconds);
+        }
+        framesCounter.Add();
+
         // Convert the image so that we can free up the camera buffer for the next frame.
-        ImagePtr convertedImage = image->Convert(PixelFormat_RGB8);
-        
-        // Free up the image from the camera buffer.
-        image->Release();
+        ImagePtr convertedImage;
+        {
+            LatencyTimer convertTimer(convertHistogram);
+            TraceSpan convertSpan("Convert", imageIndex);
+            convertedImage = image->Convert(PixelFormat_RGB8);
+            
+            // Free up the image from the camera buffer.
+            image->Release();
+        }
 
         // Let everybody know that we have received a new image.
-        OnLiveFeedImageReceived(convertedImage, imageIndex++);
+        LatencyTimer callbacksTimer(callbacksHistogram);
+        OnLiveFeedImageReceived(convertedImage, imageIndex++, timing);
+        callbacksTimer.Stop();
+
+        // The two clocks drift apart, so every so often we line them back up.
+        if(GetMonotonicTimeUs() - _lastClockSyncUs > CLOCK_SYNC_INTERVAL_US)
+        {
+            StartClockSync();
+        }
     }
 
     // Stop grabbing frames from the camera.
+    WaitForClockSync();
     _camera->EndAcquisition();
 }
 
+void FlirCamera::SyncClock()
+{
+    // Latch the camera clock a few times and keep the sample with the tightest window around it.
+    // That is the one with the least usb jitter in it.
+    try
+    {
+        int64_t bestWindowUs = INT64_MAX;
+        int64_t clockOffsetUs = 0;
+        for(int i = 0; i < CLOCK_SYNC_SAMPLES; i++)
+        {
+            int64_t beforeUs = GetMonotonicTimeUs();
+            _camera->TimestampLatch.Execute();
+            int64_t afterUs = GetMonotonicTimeUs();
+            int64_t cameraUs = _camera->TimestampLatchValue.GetValue() / 1000;
+            if(afterUs - beforeUs < bestWindowUs)
+            {
+                bestWindowUs = afterUs - beforeUs;
+                clockOffsetUs = beforeUs + (afterUs - beforeUs) / 2 - cameraUs;
+            }
+        }
+
+        // Frames keep coming in while this runs, so they only ever see a finished offset.
+        _clockOffsetUs = clockOffsetUs;
+        _hasClockOffset = true;
+        Log("Camera clock synced with offset " + to_string(clockOffsetUs) + "us (+/- " + to_string(bestWindowUs / 2) + "us)", Frames);
+    }
+    catch(const Spinnaker::Exception& e)
+    {
+        // Without the latch we can still fall back to when we received the frame.
+        _hasClockOffset = false;
+        Log("Could not sync camera clock. " + string(e.what()), Frames | tsw::utilities::Error);
+    }
+
+    _lastClockSyncUs = GetMonotonicTimeUs();
+}
+
+void FlirCamera::StartClockSync()
+{
+    // Each latch is a round trip over usb, and the acquisition thread has frames to get to.
+    // So the periodic ones happen off to the side, one at a time.
+    if(_clockSyncFuture.valid() && _clockSyncFuture.wait_for(chrono::seconds(0)) != future_status::ready)
+    {
+        return;
+    }
+
+    _lastClockSyncUs = GetMonotonicTimeUs();
+    _clockSyncFuture = Executor::Instance().Submit(STATUS_GROUP, [this]()
+    {
+        SyncClock();
+    });
+}
+
+void FlirCamera::WaitForClockSync()
+{
+    if(_clockSyncFuture.valid())
+    {
+        _clockSyncFuture.wait();
+    }
+}
+
+FrameTiming FlirCamera::GetFrameTiming(ImagePtr image, int64_t receivedUs)
+{
+    FrameTiming timing;
+    timing.receivedUs = receivedUs;
+
+    // Prefer the chunk timestamp, it is stamped at exposure rather than when the buffer got filled.
+    timing.sensorTimestampNs = image->GetChunkData().GetTimestamp();
+    if(timing.sensorTimestampNs == 0)
+    {
+        timing.sensorTimestampNs = image->GetTimeStamp();
+    }
+
+    timing.exposureUs = _hasClockOffset && timing.sensorTimestampNs > 0 ? (int64_t)(timing.sensorTimestampNs / 1000) + _clockOffsetUs : -1;
+    return timing;
+}
+
 void FlirCamera::SetFrameHeight(int frameHeight)
 {
     Log("Changing camera frame height to " + to_string(frameHeight), Debug | Frames);
-    
-    // The camera does not auto center the region of interest, so we have to do it manually.
-    // The library does not allow 2 * offset + width to exceed the max width.
-    // We can just set the offset to 0 first so we do not have to worry.
-    _camera->OffsetY = 0;
-    _camera->Height.SetValue(frameHeight);
-    _camera->OffsetY = (_camera->HeightMax.GetValue() - frameHeight) / 2;
-
     delete _userFrameHeight;
     _userFrameHeight = new int(frameHeight);
+    if(!_isConfiguring)
+    {
+        ApplyConfiguration();
+    }
     Log("Camera frame height changed", Information | Frames);
 }
 
 void FlirCamera::SetFrameWidth(int frameWidth)
 {
-    Log("Changing camera frame width to " + to_string(frameWidth), Debug | Frames);  
-    
-    // The camera does not auto center the region of interest, so we have to do it manually.
-    // The library does not allow 2 * offset + width to exceed the max width.
-    // We can just set the offset to 0 first so we do not have to worry.
-    _camera->OffsetX = 0;
-    _camera->Width.SetValue(frameWidth);
-    _camera->OffsetX = (_camera->WidthMax.GetValue() - frameWidth) / 2;
-
+    Log("Changing camera frame width to " + to_string(frameWidth), Debug | Frames);
     delete _userFrameWidth;
     _userFrameWidth = new int(frameWidth);
+    if(!_isConfiguring)
+    {
+        ApplyConfiguration();
+    }
     Log("Camera frame width changed", Information | Frames);
 }
 
@@ -321,6 +743,10 @@ bool FlirCamera::TryConnect(string serialNumber, CameraPtr* camera)
     connectedCamera->ChunkEnable = true;
     connectedCamera->ChunkModeActive = true;
     connectedCamera->RgbTransformLightSource = RgbTransformLightSource_General;
+
+    // We also want the exposure timestamp with every frame so we know how old it is.
+    connectedCamera->ChunkSelector = ChunkSelector_Timestamp;
+    connectedCamera->ChunkEnable = true;
     
     // This will make it so that we always grab the newest image.
     INodeMap& nodeMap = connectedCamera->GetTLStreamNodeMap();
@@ -340,26 +766,48 @@ bool FlirCamera::TryConnect(string serialNumber, CameraPtr* camera)
     numBufferNode->SetValue(bufferCount);
     Log("Number of camera buffers set to " + to_string(bufferCount), Frames);
 
-    _isConnected = true;
+    // Look the nodes up once here, instead of every time somebody asks about the camera.
+    _properties.Attach(connectedCamera->GetNodeMap());
+
     _connectedSerialNumber = serialNumber;
     *camera = connectedCamera;
     Log("Camera connected", Frames);
     return true;
 }
 
-void FlirCamera::WaitForConnected(bool attemptToConnect)
+void FlirCamera::SetConnected(bool isConnected)
+{
+    {
+        lock_guard<mutex> lock(_connectionLock);
+        _isConnected = isConnected;
+    }
+    _connectionCondition.notify_all();
+}
+
+void FlirCamera::WaitForConnected()
 {
-    Log("Waiting for camera to connect", Frames);
-    while(!_isConnected)
+    // The supervisor wakes us up once it has the camera back.
+    unique_lock<mutex> lock(_connectionLock);
+    if(!_isConnected)
     {
-        if(attemptToConnect && TryConnect(_connectedSerialNumber, &_camera))
+        Log("Waiting for camera to connect", Frames);
+        _connectionCondition.wait(lock, [this]()
         {
-            break;
-        }
-        
-        usleep(100000);
+            return _isConnected.load();
+        });
+        Log("Camera connected", Frames);
     }
-    Log("Camera connected", Frames);
+}
+
+bool FlirCamera::WaitForReconnect()
+{
+    // Same as above, but the live feed needs to be able to give up if somebody stops it.
+    unique_lock<mutex> lock(_connectionLock);
+    _connectionCondition.wait(lock, [this]()
+    {
+        return _isConnected || !_isLiveFeedOn;
+    });
+    return _isConnected;
 }
 
 void FlirCamera::EnsureConnectionNotLost()
@@ -370,38 +818,133 @@ void FlirCamera::EnsureConnectionNotLost()
     }
 }
 
-void FlirCamera::PowerCycle()
+void FlirCamera::StartSupervisor()
 {
-    Log("Power cycling camera", Frames);
-    //Log("DeInit camera", Frames);
-    //_camera->DeInit();
-    Log("Resetting camera device", Frames);
-    _camera->DeviceReset();
+    if(!_isSupervising)
+    {
+        _isSupervising = true;
+        _supervisorFuture = Executor::Instance().Submit(ACQUISITION_GROUP, [this]()
+        {
+            Supervise();
+        });
+    }
+}
 
-    // Now we need to wait for the camerato be connected again.
-    WaitForConnected(true);
+void FlirCamera::StopSupervisor()
+{
+    if(_isSupervising)
+    {
+        _isSupervising = false;
+        _lostSignal.Notify();
+        _supervisorFuture.wait();
+    }
+}
 
-    // Apply the settings that were previously set.
-    Log("Applying original camera user settings", Frames);
-    if(_userFrameWidth)
+bool FlirCamera::RecoverAcquisition()
+{
+    while(true)
     {
-        SetFrameWidth(*_userFrameWidth);
+        SetConnected(false);
+        _lostSignal.Notify();
+        if(!WaitForReconnect())
+        {
+            return false;
+        }
+
+        // It can go away again before we even get started, in which case it is back to waiting.
+        try
+        {
+            Log("Frame acquisition resuming", Frames);
+            _camera->BeginAcquisition();
+
+            // The reconnect reset the camera's clock too. One from before it went away would only get in the way.
+            WaitForClockSync();
+            SyncClock();
+            return true;
+        }
+        catch(const exception& e)
+        {
+            Log("Could not resume frame acquisition. " + string(e.what()), Frames | tsw::utilities::Error);
+        }
     }
+}
 
-    if(_userFrameHeight)
+void FlirCamera::Supervise()
+{
+    // Sleep until the live feed says the camera went away.
+    while(_isSupervising)
     {
-        SetFrameHeight(*_userFrameHeight);
+        if(_lostSignal.Wait() && _isSupervising && !_isConnected)
+        {
+            // If this dies, the live feed waits on us forever, so nothing gets out.
+            try
+            {
+                Reconnect();
+            }
+            catch(const exception& e)
+            {
+                Log("Camera reconnect failed. " + string(e.what()), Frames | tsw::utilities::Error);
+                _lostSignal.Notify();
+            }
+        }
     }
+}
+
+void FlirCamera::Reconnect()
+{
+    static LatencyHistogram& recoverHistogram = MetricsRegistry::Instance().GetHistogram("camera.recover_us");
+    static Counter& reconnectsCounter = MetricsRegistry::Instance().GetCounter("camera.reconnects");
+    int64_t lostUs = GetMonotonicTimeUs();
+    PublishConnectionState(CameraLost);
 
-    if(_userFrameRate)
+    // A reset usually clears it up. If the camera already fell off the bus it won't work, but we still wait for it to come back.
+    Log("Resetting camera device", Frames);
+    try
+    {
+        _camera->DeviceReset();
+    }
+    catch(const exception& e)
     {
-        SetFrameRate(*_userFrameRate);
+        Log("Could not reset camera. " + string(e.what()), Frames | tsw::utilities::Error);
     }
 
-    if(_userFilter)
+    // Everything we knew about its nodes went with it.
+    _properties.Detach();
+
+    Backoff backoff(CAMERA_RECONNECT_INITIAL_MS, CAMERA_RECONNECT_MAX_MS);
+    while(_isSupervising)
+    {
+        try
+        {
+            if(TryConnect(_connectedSerialNumber, &_camera))
+            {
+                // Apply the settings that were previously set, before anybody gets to start using it.
+                // Holding the lock until we say we are connected means nothing set in the meantime gets lost.
+                Log("Applying original camera user settings", Frames);
+                lock_guard<mutex> lock(_configurationLock);
+                WriteConfiguration();
+                SetConnected(true);
+                break;
+            }
+        }
+        catch(const exception& e)
+        {
+            // Spinnaker or us not finding a node, either way it just gets another try.
+            Log("Could not reconnect to camera. " + string(e.what()), Frames | tsw::utilities::Error);
+            _properties.Detach();
+        }
+
+        // Sleeping on the lost signal means stopping doesn't have to wait out the backoff.
+        _lostSignal.Wait(backoff.NextDelayMs());
+    }
+
+    if(!_isSupervising)
     {
-        SetFilter(*_userFilter);
+        return;
     }
 
-    Log("Camera power cycle finished", Frames);
+    reconnectsCounter.Add();
+    recoverHistogram.Record(GetMonotonicTimeUs() - lostUs);
+    Log("Camera recovered after " + to_string((GetMonotonicTimeUs() - lostUs) / 1000) + "ms", Frames | Information);
+    PublishConnectionState(CameraConnected);
 }
@@ -0,0 +1,155 @@
+#include "imaging.hpp"
+#include <sstream>
+#include <iomanip>
+
+using namespace tsw::imaging;
+
+FrameRateGovernor::FrameRateGovernor(FlirCamera& camera, FrameRateGovernorConfig config, double frameRate)
+{
+    _camera = &camera;
+    _config = config;
+    _isGoverning = false;
+
+    // Start from whatever we were told to run at, as long as it is in bounds.
+    _frameRate = max(config.minRate, min(config.maxRate, frameRate));
+}
+
+FrameRateGovernor::~FrameRateGovernor()
+{
+    Stop();
+}
+
+void FrameRateGovernor::Start()
+{
+    if(!_isGoverning)
+    {
+        // Pick up where the last run left off, that is the best guess of what we can handle.
+        ChangeFrameRate(_frameRate, "starting");
+        _isGoverning = true;
+        _stopSignal.Clear();
+        _governFuture = Executor::Instance().Submit(STATUS_GROUP, [this]()
+        {
+            Govern();
+        });
+    }
+}
+
+void FrameRateGovernor::Stop()
+{
+    if(_isGoverning)
+    {
+        _isGoverning = false;
+        _stopSignal.Notify();
+        _governFuture.wait();
+    }
+}
+
+bool FrameRateGovernor::IsGoverning()
+{
+    return _isGoverning;
+}
+
+double FrameRateGovernor::GetFrameRate()
+{
+    return _frameRate;
+}
+
+void FrameRateGovernor::Govern()
+{
+    // The camera and recorders already keep track of everything we need.
+    MetricsRegistry& metrics = MetricsRegistry::Instance();
+    LatencyHistogram& callbacksHistogram = metrics.GetHistogram("camera.callbacks_us");
+    Counter& droppedCounter = metrics.GetCounter("camera.dropped_frames");
+    Gauge& footageBacklogGauge = metrics.GetGauge("recorder.footage.backlog");
+    Gauge& filterBacklogGauge = metrics.GetGauge("recorder.filter.backlog");
+    Gauge& loadGauge = metrics.GetGauge("governor.load");
+    Log("Governing frame rate between " + to_string(_config.minRate) + " and " + to_string(_config.maxRate) + "fps", Frames | Information);
+
+    // Those are all totals since we started, so each interval only looks at what changed.
+    HistogramSummary lastCallbacks = callbacksHistogram.Summarize();
+    uint64_t lastDropped = droppedCounter.Get();
+    int calmIntervals = 0;
+    bool isSettling = false;
+    while(_isGoverning)
+    {
+        _stopSignal.Wait(_config.interval);
+        if(!_isGoverning)
+        {
+            break;
+        }
+
+        HistogramSummary callbacks = callbacksHistogram.Summarize();
+        uint64_t dropped = droppedCounter.Get();
+        uint64_t frames = callbacks.count - lastCallbacks.count;
+        double busyUs = GetTotal(callbacks) - GetTotal(lastCallbacks);
+        uint64_t droppedFrames = dropped - lastDropped;
+        lastCallbacks = callbacks;
+        lastDropped = dropped;
+
+        // No frames means no camera, and the supervisor is already on that.
+        // Right after a change, the numbers are a mix of both rates, so give it an interval to settle.
+        if(frames == 0 || isSettling)
+        {
+            isSettling = false;
+            continue;
+        }
+
+        // How much of each frame's time went to dealing with it. Past 1, frames pile up in the buffers and get thrown away.
+        double load = busyUs / frames * _frameRate / 1000000;
+        double dropProportion = droppedFrames / (double)(frames + droppedFrames);
+        double backlog = max(footageBacklogGauge.Get(), filterBacklogGauge.Get());
+        loadGauge.Set(load);
+
+        stringstream reason;
+        reason << fixed << setprecision(2) << "load " << load << ", " << droppedFrames << " dropped, backlog " << backlog;
+        if(load > _config.maxLoad || dropProportion > GOVERNOR_MAX_DROP_PROPORTION || backlog > _config.maxBacklog)
+        {
+            // Back off right away, falling behind is worse than a few less frames.
+            calmIntervals = 0;
+            isSettling = ChangeFrameRate(_frameRate - _config.step, reason.str());
+            continue;
+        }
+
+        // Only speed up if it looks like we could still keep up at the faster rate, and have for a while.
+        double raisedRate = min(_config.maxRate, _frameRate + _config.step);
+        bool canRaise = raisedRate > _frameRate && load * raisedRate / _frameRate <= _config.maxLoad && droppedFrames == 0;
+        calmIntervals = canRaise ? calmIntervals + 1 : 0;
+        if(calmIntervals >= _config.raiseIntervals)
+        {
+            calmIntervals = 0;
+            isSettling = ChangeFrameRate(raisedRate, reason.str());
+        }
+    }
+}
+
+double FrameRateGovernor::GetTotal(HistogramSummary& summary)
+{
+    // An empty histogram has no mean, and NaN would stick around in every interval after it.
+    return summary.count ? summary.mean * summary.count : 0;
+}
+
+bool FrameRateGovernor::ChangeFrameRate(double hertz, string reason)
+{
+    static Gauge& rateGauge = MetricsRegistry::Instance().GetGauge("governor.fps");
+    hertz = max(_config.minRate, min(_config.maxRate, hertz));
+    if(hertz == _frameRate && _isGoverning)
+    {
+        return false;
+    }
+
+    try
+    {
+        _camera->SetFrameRate(hertz);
+    }
+    catch(const Spinnaker::Exception& e)
+    {
+        // The camera's max depends on the size and exposure, so it might just not go that fast right now.
+        Log("Could not change frame rate to " + to_string(hertz) + "fps. " + string(e.what()), Frames | tsw::utilities::Error);
+        return false;
+    }
+
+    Log("Frame rate governor set " + to_string(hertz) + "fps (" + reason + ")", Frames | Information);
+    _frameRate = hertz;
+    rateGauge.Set(hertz);
+    return true;
+}
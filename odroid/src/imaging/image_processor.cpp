@@ -1,6 +1,8 @@
 #include "imaging.hpp"
 #include "settings.hpp"
 #include <functional>
+#include <chrono>
+#include <sstream>
 
 using namespace tsw::imaging;
 using namespace tsw::io::settings;
@@ -12,6 +14,9 @@ ImageProcessor::ImageProcessor(DisplayWindow& window, FlirCamera& camera, SmartO
     double fps = camera.GetFrameRate();
     _footageRecorder = new Recorder(frameSize, fps);
     _filterRecorder = new Recorder(frameSize, fps);
+    _footageRecorder->Name = "recorder.footage";
+    _filterRecorder->Name = "recorder.filter";
+    _detectionWriter = new DetectionWriter();
     _processNum = 0;
 
     _window = &window;
@@ -20,6 +25,15 @@ ImageProcessor::ImageProcessor(DisplayWindow& window, FlirCamera& camera, SmartO
     _motionController = &motionController;
     _config = config;
     _isProcessing = false;
+
+    // Everything downstream thinks in terms of this frame, no matter how the camera is reading it out.
+    _frameSize = frameSize;
+    AdaptiveReadout.enabled = false;
+    _stableFrames = 0;
+    _lostFrames = 0;
+    _isReadoutNarrow = false;
+    _lastReadout = { 1, 1 };
+    _framesSinceSwitch = 0;
 }
 
 void ImageProcessor::StartProcessing()
@@ -28,7 +42,7 @@ void ImageProcessor::StartProcessing()
     {
         _processNum++;
 
-        if(_config.recordFrames || _config.displayFrames || _config.moveCamera || _config.recordFilter)
+        if(_config.recordFrames || _config.displayFrames || _config.moveCamera || _config.recordFilter || _config.recordDetections)
         {
             _livefeedCallbackKey = _camera->RegisterLiveFeedCallback(bind(&ImageProcessor::OnLiveFeedImageReceived, this, placeholders::_1));
 
@@ -42,14 +56,32 @@ void ImageProcessor::StartProcessing()
                 _filterRecorder->StartRecording(to_string(_processNum) + "_OfficerFilter.avi");
             }
 
+            if(_config.recordDetections)
+            {
+                _detectionWriter->Open(to_string(_processNum) + "_OfficerDetections.tswd", _camera->GetFrameWidth(), _camera->GetFrameHeight(), _camera->GetFrameRate());
+            }
+
             if(_config.displayFrames)
             {
                 _window->Show();
             }
 
+            // Nobody is there yet, so start out looking at everything.
+            if(AdaptiveReadout.enabled)
+            {
+                _stableFrames = 0;
+                _lostFrames = 0;
+                _isReadoutNarrow = false;
+                _framesSinceSwitch = 0;
+                _camera->SetReadout({ AdaptiveReadout.wideBinning, 1 });
+            }
+
             if(_config.moveCamera)
             {
                 _motionController->InitializeGuidance();
+
+                // No point steering off of frames we aren't getting.
+                _connectionCallbackKey = _camera->RegisterConnectionCallback(bind(&ImageProcessor::OnCameraConnectionChanged, this, placeholders::_1));
             }
         }
         
@@ -62,7 +94,7 @@ void ImageProcessor::StopProcessing()
 {
     if(IsProcessing())
     {
-        if(_config.recordFrames || _config.displayFrames || _config.moveCamera || _config.recordFilter)
+        if(_config.recordFrames || _config.displayFrames || _config.moveCamera || _config.recordFilter || _config.recordDetections)
         {
             _camera->UnregisterLiveFeedCallback(_livefeedCallbackKey);
 
@@ -76,39 +108,159 @@ void ImageProcessor::StopProcessing()
                 _filterRecorder->StopRecording();
             }
 
+            if(_config.recordDetections)
+            {
+                _detectionWriter->Close();
+            }
+
             if(_config.displayFrames)
             {
                 _window->Close();
             }
 
+            // Whoever uses the camera next expects the whole frame.
+            if(AdaptiveReadout.enabled)
+            {
+                _camera->SetReadout({ 1, 1 });
+            }
+
             if(_config.moveCamera)
             {
+                _camera->UnregisterConnectionCallback(_connectionCallbackKey);
                 _motionController->UninitializeGuidance();
             }
         }
         _camera->UnregisterLiveFeedCallback(_livefeedCallbackKey);
         _isProcessing = false;
+        LogLatencyReport();
+    }
+}
+
+void ImageProcessor::OnCameraConnectionChanged(CameraConnectionState state)
+{
+    // The recordings just pick back up where they left off, only the motors care.
+    if(state == CameraLost)
+    {
+        _motionController->PauseGuidance();
+    }
+    else
+    {
+        _motionController->ResumeGuidance();
     }
 }
 
 void ImageProcessor::OnLiveFeedImageReceived(LiveFeedCallbackArgs args)
 {
     // Find the desired bounding box on the oficer.
-    OfficerInferenceBox* bestBox = _officerLocator->GetOfficerBox(args.image);
+    vector<OfficerInferenceBox> boxes;
+
+    // The tracks and their color scores are in the old readout's pixels, so none of them line up anymore.
+    // Start them over instead of letting them all fail to match and look like we lost the officer.
+    if(AdaptiveReadout.enabled && (args.readout.binning != _lastReadout.binning || args.readout.crop != _lastReadout.crop))
+    {
+        _officerLocator->Tracks.Reset();
+        _lastReadout = args.readout;
+        _framesSinceSwitch = 0;
+        _stableFrames = 0;
+        _lostFrames = 0;
+    }
+
+    OfficerInferenceBox* bestBox = _officerLocator->GetOfficerBox(args.image, boxes);
+    if(AdaptiveReadout.enabled)
+    {
+        UpdateReadout(args, bestBox);
+    }
+
+    static LatencyHistogram& decisionHistogram = MetricsRegistry::Instance().GetHistogram("latency.host_to_decision_us");
+    static LatencyHistogram& ackHistogram = MetricsRegistry::Instance().GetHistogram("latency.decision_to_ack_us");
+    static LatencyHistogram& glassToAckHistogram = MetricsRegistry::Instance().GetHistogram("latency.glass_to_ack_us");
+    static Counter& staleCounter = MetricsRegistry::Instance().GetCounter("guidance.stale_frames");
+    static Counter& slewingCounter = MetricsRegistry::Instance().GetCounter("guidance.slewing_frames");
 
     // Do the motion first, since that is the only time sensitive thing really.
-    if(_config.moveCamera && args.imageIndex % CameraFramesToSkip == 0)
+    OfficerDirection dir;
+    bool guided = false;
+    bool commandIssued = false;
+    bool stale = false;
+    bool slewing = false;
+
+    // The control loop keeps its own schedule, so it gets every frame and just uses the newest.
+    bool hasControlLoop = _motionController->IsControlLoopRunning();
+    // Frames can beat the reconnect news here, so don't guide until guidance says it is back.
+    if(_config.moveCamera && !_motionController->IsGuidancePaused() && (hasControlLoop || args.imageIndex % CameraFramesToSkip == 0))
     {
-        // Based on the best box, see where we need to go.
-        OfficerDirection dir = _officerLocator->FindOfficer(args.image, bestBox);
+        // Moving towards where the officer was a while ago just makes us chase ghosts.
+        int64_t frameTimeUs = args.timing.exposureUs >= 0 ? args.timing.exposureUs : args.timing.receivedUs;
+        int64_t frameAgeUs = GetMonotonicTimeUs() - frameTimeUs;
+        if(_config.maxFrameAge > 0 && frameAgeUs > _config.maxFrameAge * 1000)
+        {
+            stale = true;
+            staleCounter.Add();
+            Log("Frame # " + to_string(args.imageIndex) + " is " + to_string(frameAgeUs / 1000) + "ms old, skipping guidance", Frames | Movements);
+        }
+        else if(_motionController->MotionGating.enabled && _motionController->IsSlewing(frameTimeUs))
+        {
+            // Taken mid swing, so wait for one that the officer isn't smeared across.
+            slewing = true;
+            slewingCounter.Add();
+            Log("Frame # " + to_string(args.imageIndex) + " was taken while slewing, skipping guidance", Frames | Movements);
+        }
+        else
+        {
+            // Based on the best box, see where we need to go.
+            // The readout may be binned or cropped, but the fov and regions are all for the full frame.
+            if(AdaptiveReadout.enabled)
+            {
+                OfficerInferenceBox fullBox;
+                if(bestBox)
+                {
+                    fullBox = ToFullFrame(*bestBox, args);
+                }
+                dir = _officerLocator->FindOfficer(bestBox ? &fullBox : nullptr, _frameSize.width, _frameSize.height);
+            }
+            else
+            {
+                dir = _officerLocator->FindOfficer(args.image, bestBox);
+            }
+            int64_t decisionUs = GetMonotonicTimeUs();
+            decisionHistogram.Record(decisionUs - args.timing.receivedUs);
+
+            guided = true;
+            if(hasControlLoop)
+            {
+                // The loop picks it up on its next tick.
+                _motionController->SubmitTarget(dir, frameTimeUs);
+            }
+            else
+            {
+                // Guidance doesn't always send a move, so check if the motors got a new one.
+                TraceSpan guidanceSpan("Guidance");
+                uint lastSequence = _motionController->GetLastMotorCommand().sequence;
+                _motionController->GuideCameraTo(dir, frameTimeUs);
+                commandIssued = _motionController->GetLastMotorCommand().sequence != lastSequence;
+
+                // Guidance waits on the acks, so once we are back the motors have the command.
+                if(commandIssued)
+                {
+                    int64_t ackUs = GetMonotonicTimeUs();
+                    ackHistogram.Record(ackUs - decisionUs);
+                    glassToAckHistogram.Record(ackUs - frameTimeUs);
+                }
+            }
+        }
+    }
 
-        _motionController->GuideCameraTo(dir);
+    if(_config.recordDetections)
+    {
+        WriteDetections(args, boxes, bestBox, guided ? &dir : nullptr, commandIssued, stale, slewing);
     }
 
     if(_config.recordFrames || _config.displayFrames || _config.recordFilter)
     {
+        TraceSpan annotateSpan("Annotate");
+
         // Make an opencv image out of the FLIR image.
-        Mat cvImage = MatFromImage(args.image, bestBox);
+        Mat cvImage = MatFromImage(args.image);
 
         if(_config.recordFrames || _config.displayFrames)
         {
@@ -118,7 +270,7 @@ void ImageProcessor::OnLiveFeedImageReceived(LiveFeedCallbackArgs args)
             if(_config.recordFrames)
             {
                 Log("Adding frame # " + to_string(args.imageIndex) + " to footage recording buffer", Recording);
-                _footageRecorder->AddFrame(footageFrame);
+                _footageRecorder->AddFrame(footageFrame, args.imageIndex, args.timing.receivedUs);
                 Log("Frame added to footage recording buffer", Recording);
             }
 
@@ -138,10 +290,147 @@ void ImageProcessor::OnLiveFeedImageReceived(LiveFeedCallbackArgs args)
             Mat filteredColor;
             cvtColor(threshold, filteredColor, COLOR_GRAY2RGB);
             DrawOfficerBox(bestBox, &filteredColor, Scalar(255, 50, 50));
-            _filterRecorder->AddFrame(filteredColor);
+            _filterRecorder->AddFrame(filteredColor, args.imageIndex, args.timing.receivedUs);
             Log("Frame added to filter recording buffer", Recording);
         }
     }
+
+    delete bestBox;
+}
+
+void ImageProcessor::UpdateReadout(LiveFeedCallbackArgs& args, OfficerInferenceBox* bestBox)
+{
+    // One odd frame shouldn't flip the readout back and forth, so it takes a few in a row.
+    _framesSinceSwitch++;
+    if(bestBox)
+    {
+        _stableFrames++;
+        _lostFrames = 0;
+    }
+    else
+    {
+        _lostFrames++;
+        _stableFrames = 0;
+    }
+
+    // Getting close to the edge of the crop means they are about to walk right out of it.
+    bool isNearEdge = false;
+    if(bestBox && args.readout.crop < 1)
+    {
+        int width = args.image->GetWidth();
+        int height = args.image->GetHeight();
+        int marginX = width * READOUT_EDGE_MARGIN;
+        int marginY = height * READOUT_EDGE_MARGIN;
+        isNearEdge = bestBox->topLeftX < marginX || bestBox->bottomRightX > width - marginX || bestBox->topLeftY < marginY || bestBox->bottomRightY > height - marginY;
+    }
+
+    // Whatever we switch to gets a fair shot before we change our mind, unless they are walking out of the crop.
+    bool isHolding = _framesSinceSwitch < AdaptiveReadout.holdFrames;
+    if(!_isReadoutNarrow && !isHolding && _stableFrames >= AdaptiveReadout.stableFrames)
+    {
+        // The gimbal keeps them in the middle, so the middle is all we need to read.
+        Log("Officer track is stable, cropping camera readout", Frames | Officers);
+        _isReadoutNarrow = true;
+        _framesSinceSwitch = 0;
+        _camera->SetReadout({ 1, AdaptiveReadout.trackingCrop });
+    }
+    else if(_isReadoutNarrow && ((!isHolding && _lostFrames >= AdaptiveReadout.lostFrames) || isNearEdge))
+    {
+        Log("Officer track lost, widening camera readout", Frames | Officers);
+        _isReadoutNarrow = false;
+        _stableFrames = 0;
+        _framesSinceSwitch = 0;
+        _camera->SetReadout({ AdaptiveReadout.wideBinning, 1 });
+    }
+}
+
+OfficerInferenceBox ImageProcessor::ToFullFrame(OfficerInferenceBox box, LiveFeedCallbackArgs& args)
+{
+    // The readout is always centered, so this is just a scale about the middle of the frame.
+    double centerX = args.image->GetWidth() / 2.0;
+    double centerY = args.image->GetHeight() / 2.0;
+    int binning = args.readout.binning;
+    box.topLeftX = _frameSize.width / 2.0 + (box.topLeftX - centerX) * binning;
+    box.topLeftY = _frameSize.height / 2.0 + (box.topLeftY - centerY) * binning;
+    box.bottomRightX = _frameSize.width / 2.0 + (box.bottomRightX - centerX) * binning;
+    box.bottomRightY = _frameSize.height / 2.0 + (box.bottomRightY - centerY) * binning;
+    return box;
+}
+
+void ImageProcessor::WriteDetections(LiveFeedCallbackArgs& args, vector<OfficerInferenceBox>& boxes, OfficerInferenceBox* bestBox, OfficerDirection* dir, bool commandIssued, bool stale, bool slewing)
+{
+    DetectionFrameRecord record = { };
+    record.frameIndex = args.imageIndex;
+    record.timestampUs = args.timing.exposureUs >= 0 ? args.timing.exposureUs : args.timing.receivedUs;
+    record.flags |= stale ? DETECTION_FLAG_STALE : 0;
+    record.flags |= slewing ? DETECTION_FLAG_SLEWING : 0;
+
+    if(bestBox)
+    {
+        record.flags |= DETECTION_FLAG_HAS_CHOSEN_BOX;
+        record.chosenBox = AdaptiveReadout.enabled ? ToFullFrame(*bestBox, args) : *bestBox;
+    }
+
+    // Guidance only runs on some frames, so the direction may not exist for this one.
+    if(dir)
+    {
+        record.flags |= DETECTION_FLAG_GUIDED;
+        record.flags |= dir->foundOfficer ? DETECTION_FLAG_FOUND_OFFICER : 0;
+        if(dir->foundOfficer)
+        {
+            record.flags |= dir->shouldMove ? DETECTION_FLAG_SHOULD_MOVE : 0;
+            record.region = dir->region;
+            record.movementX = dir->movement.x;
+            record.movementY = dir->movement.y;
+        }
+    }
+
+    if(commandIssued)
+    {
+        MotorCommand command = _motionController->GetLastMotorCommand();
+        record.flags |= DETECTION_FLAG_COMMAND_ISSUED;
+        record.commandAction = command.action;
+        record.commandHorizontal = command.horizontal;
+        record.commandVertical = command.vertical;
+    }
+
+    // The file says how big the frame is up front, so the boxes have to match that.
+    if(AdaptiveReadout.enabled)
+    {
+        vector<OfficerInferenceBox> fullBoxes;
+        for(OfficerInferenceBox& box : boxes)
+        {
+            fullBoxes.push_back(ToFullFrame(box, args));
+        }
+        _detectionWriter->WriteFrame(record, fullBoxes);
+        return;
+    }
+
+    _detectionWriter->WriteFrame(record, boxes);
+}
+
+void ImageProcessor::LogLatencyReport()
+{
+    // These are cumulative, so this covers every run since we started.
+    MetricsRegistry& metrics = MetricsRegistry::Instance();
+    const char* stages[] = { "exposure_to_host", "host_to_decision", "decision_to_ack", "glass_to_ack" };
+    stringstream report;
+    report << "Latency report (us):";
+    for(const char* stage : stages)
+    {
+        HistogramSummary summary = metrics.GetHistogram("latency." + string(stage) + "_us").Summarize();
+        report << "\n  " << stage << ": n=" << summary.count << " p50=" << summary.p50 << " p90=" << summary.p90 << " p99=" << summary.p99 << " max=" << summary.max;
+    }
+    HistogramSummary startSummary = metrics.GetHistogram("guidance.start_us").Summarize();
+    report << "\n  guidance start: n=" << startSummary.count << " p50=" << startSummary.p50 << " max=" << startSummary.max;
+    report << "\n  stale frames: " << metrics.GetCounter("guidance.stale_frames").Get();
+    report << "\n  slewing frames: " << metrics.GetCounter("guidance.slewing_frames").Get();
+    report << "\n  guidance overruns: " << metrics.GetCounter("guidance.overruns").Get();
+    HistogramSummary recoverSummary = metrics.GetHistogram("camera.recover_us").Summarize();
+    report << "\n  governed frame rate: " << metrics.GetGauge("governor.fps").Get() << "fps, load " << metrics.GetGauge("governor.load").Get();
+    report << "\n  camera recoveries: n=" << recoverSummary.count << " p50=" << recoverSummary.p50 << " max=" << recoverSummary.max;
+    report << "\n  color cache: hits=" << metrics.GetCounter("locator.color_cache_hits").Get() << " misses=" << metrics.GetCounter("locator.color_cache_misses").Get();
+    Log(report.str(), Information | Frames);
 }
 
 bool ImageProcessor::IsProcessing()
@@ -163,7 +452,7 @@ void ImageProcessor::DrawOfficerBox(OfficerInferenceBox* officerBox, Mat* cvImag
     }
 }
 
-Mat ImageProcessor::MatFromImage(ImagePtr image, OfficerInferenceBox* officerBox)
+Mat ImageProcessor::MatFromImage(ImagePtr image)
 {
     // Put the pointer into an array of bytes.
     unsigned char* data = (unsigned char*)image->GetData();
@@ -178,4 +467,5 @@ ImageProcessor::~ImageProcessor()
 {
     delete _footageRecorder;
     delete _filterRecorder;
+    delete _detectionWriter;
 }
\ No newline at end of file
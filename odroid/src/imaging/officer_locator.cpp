@@ -12,6 +12,7 @@ OfficerLocator::OfficerLocator(int16_t officerClassId)
 
     // We accept all boxes by default.
     ConfidenceThreshold = 0;
+    _isTravelingToTarget = false;
 }
 
 OfficerDirection OfficerLocator::FindOfficer(ImagePtr image)
@@ -26,6 +27,7 @@ OfficerDirection OfficerLocator::FindOfficer(ImagePtr image)
         
         OfficerDirection res;
         res.foundOfficer = false;
+        res.region = OutsideRegions;
         return res;
     }
 
@@ -38,6 +40,11 @@ OfficerDirection OfficerLocator::FindOfficer(ImagePtr image)
 }
 
 OfficerDirection OfficerLocator::FindOfficer(ImagePtr image, OfficerInferenceBox* officerBox)
+{
+    return FindOfficer(officerBox, image->GetWidth(), image->GetHeight());
+}
+
+OfficerDirection OfficerLocator::FindOfficer(OfficerInferenceBox* officerBox, int frameWidth, int frameHeight)
 {
     // This will hold the result.
     OfficerDirection res;
@@ -46,6 +53,7 @@ OfficerDirection OfficerLocator::FindOfficer(ImagePtr image, OfficerInferenceBox
     if(!officerBox)
     {
         res.foundOfficer = false;
+        res.region = OutsideRegions;
         return res;
     }
 
@@ -56,13 +64,15 @@ OfficerDirection OfficerLocator::FindOfficer(ImagePtr image, OfficerInferenceBox
 
     // We have a location, now determine if we actually have to get there.
     // This is taking into account the region we found the officer in and the last region the officer was in.
-    RegionLocation region = GetRegionLocation(officerLoc, image);
+    OfficerRegion region = GetRegionLocation(officerLoc, frameWidth, frameHeight);
     Log("Found officer in region: " + to_string(region), Officers);
+    res.foundOfficer = true;
+    res.region = region;
 
     // The two cases that warrant no moving are:
     // 1. We are in the target region
     // 2. We are in the safe region and are not currently attempting to move to the target region.
-    if(region == Target || (region == Safe && !_isTravelingToTarget))
+    if(region == TargetRegion || (region == SafeRegion && !_isTravelingToTarget))
     {
         // We have to reset the flag that indicates we are attempting to move to the target, otherwise the officer will move to target once it hits the safe region.
         _isTravelingToTarget = false;
@@ -78,45 +88,77 @@ OfficerDirection OfficerLocator::FindOfficer(ImagePtr image, OfficerInferenceBox
     
     // First transform the location of the officer into [-1, 1] space (from left to right).
     // Keep in mind that we have to reverse the y axis.
-    officerLoc.x = officerLoc.x / (image->GetWidth() / 2) - 1;
-    officerLoc.y = 1 - officerLoc.y / (image->GetHeight() / 2);
+    officerLoc.x = officerLoc.x / (frameWidth / 2) - 1;
+    officerLoc.y = 1 - officerLoc.y / (frameHeight / 2);
 
     // That actually is the direction we want to move the officer.
     // Just transfor the point data over and we can delete the unmanaged point.
     res.movement.x = officerLoc.x;
     res.movement.y = officerLoc.y;
 
+    // The tracker wants to know how big they are too, as a proportion of the frame.
+    res.size.x = (officerBox->bottomRightX - officerBox->topLeftX) / (double)frameWidth;
+    res.size.y = (officerBox->bottomRightY - officerBox->topLeftY) / (double)frameHeight;
+
     return res;
 }
 
 OfficerInferenceBox* OfficerLocator::GetOfficerBox(ImagePtr image)
 {
-    vector<OfficerInferenceBox> boxes = GetOfficerLocations(image);
-    Log("Found " + to_string(boxes.size()) + " bounding boxes", Officers);
-    return GetDesiredOfficerBox(boxes, image);
+    vector<OfficerInferenceBox> boxes;
+    return GetOfficerBox(image, boxes);
+}
+
+OfficerInferenceBox* OfficerLocator::GetOfficerBox(ImagePtr image, vector<OfficerInferenceBox>& officerBoxes)
+{
+    static LatencyHistogram& locateHistogram = MetricsRegistry::Instance().GetHistogram("locator.locate_us");
+    static Gauge& boxesGauge = MetricsRegistry::Instance().GetGauge("locator.boxes");
+    LatencyTimer locateTimer(locateHistogram);
+
+    // The caller gets to keep all of the boxes we looked at, not just the one we picked.
+    {
+        TraceSpan parseSpan("ParseChunks");
+        officerBoxes = GetOfficerLocations(image);
+    }
+    boxesGauge.Set(officerBoxes.size());
+    Log("Found " + to_string(officerBoxes.size()) + " bounding boxes", Officers);
+
+    TraceSpan scoreSpan("ScoreBoxes");
+    return GetDesiredOfficerBox(officerBoxes, image);
 }
 
 vector<OfficerInferenceBox> OfficerLocator::GetOfficerLocations(ImagePtr image)
+{
+    // Pull the raw boxes out of the chunk data.
+    vector<InferenceBoundingBox> rawBoxes;
+    InferenceBoundingBoxResult boxRes = image->GetChunkData().GetInferenceBoundingBoxResult();
+    for(int i = 0; i < boxRes.GetBoxCount(); i++)
+    {
+        rawBoxes.push_back(boxRes.GetBoxAt(i));
+    }
+
+    return GetOfficerLocations(rawBoxes, image->GetWidth(), image->GetHeight());
+}
+
+vector<OfficerInferenceBox> OfficerLocator::GetOfficerLocations(vector<InferenceBoundingBox>& rawBoxes, int frameWidth, int frameHeight)
 {
     // This will hold all of the bounding boxes.
     vector<OfficerInferenceBox> boxes;
 
     // Iterate over all of the boxes and add them to our vector;
-    InferenceBoundingBoxResult boxRes = image->GetChunkData().GetInferenceBoundingBoxResult();
-    for(int i = 0; i < boxRes.GetBoxCount(); i++)
+    for(InferenceBoundingBox& box : rawBoxes)
     {
         // We only want the boxes that coorespond to the officer class and have a certain amount of confidence.
-        InferenceBoundingBox box = boxRes.GetBoxAt(i);
         if(box.classId == OfficerClassId && box.confidence >= ConfidenceThreshold)
         {
             OfficerInferenceBox officerBox;
             officerBox.confidence = box.confidence;
 
             // The coordinates need to be cleaned up because flir thought it would be a cool idea to allow them to exist outside the frame!
-            officerBox.bottomRightX = CleanCoordinate(box.rect.bottomRightXCoord, image->GetWidth() - 1);
-            officerBox.bottomRightY = CleanCoordinate(box.rect.bottomRightYCoord, image->GetHeight() - 1);
-            officerBox.topLeftX = CleanCoordinate(box.rect.topLeftXCoord, image->GetWidth() - 1);
-            officerBox.topLeftY = CleanCoordinate(box.rect.topLeftYCoord, image->GetHeight() - 1);
+            officerBox.bottomRightX = CleanCoordinate(box.rect.bottomRightXCoord, frameWidth - 1);
+            officerBox.bottomRightY = CleanCoordinate(box.rect.bottomRightYCoord, frameHeight - 1);
+            officerBox.topLeftX = CleanCoordinate(box.rect.topLeftXCoord, frameWidth - 1);
+            officerBox.topLeftY = CleanCoordinate(box.rect.topLeftYCoord, frameHeight - 1);
 
             boxes.push_back(officerBox);
         }
@@ -125,34 +167,34 @@ vector<OfficerInferenceBox> OfficerLocator::GetOfficerLocations(ImagePtr image)
     return boxes;
 }
 
-OfficerLocator::RegionLocation OfficerLocator::GetRegionLocation(Vector2 location, ImagePtr image)
+OfficerRegion OfficerLocator::GetRegionLocation(Vector2 location, int frameWidth, int frameHeight)
 {
-    if(IsPointInRegion(location, TargetRegionProportion, image))
+    if(IsPointInRegion(location, TargetRegionProportion, frameWidth, frameHeight))
     {
-        return Target;
+        return TargetRegion;
     }
 
-    if(IsPointInRegion(location, SafeRegionProportion, image))
+    if(IsPointInRegion(location, SafeRegionProportion, frameWidth, frameHeight))
     {
-        return Safe;
+        return SafeRegion;
     }
 
     // We are not in any regions.
-    return None;
+    return OutsideRegions;
 }
 
-bool OfficerLocator::IsPointInRegion(Vector2 location, Vector2 region, ImagePtr image)
+bool OfficerLocator::IsPointInRegion(Vector2 location, Vector2 region, int frameWidth, int frameHeight)
 {
-    double regionLeft = (0.5 - region.x / 2) * image->GetWidth();
+    double regionLeft = (0.5 - region.x / 2) * frameWidth;
     if(location.x > regionLeft)
     {
-        double regionRight = (0.5 + region.x / 2) * image->GetWidth();
+        double regionRight = (0.5 + region.x / 2) * frameWidth;
         if(location.x < regionRight)
         {
-            double regionTop = (0.5 - region.x / 2) * image->GetHeight();
+            double regionTop = (0.5 - region.y / 2) * frameHeight;
             if(location.y > regionTop)
             {
-                double regionBottom = (0.5 + region.y / 2) * image->GetHeight();
+                double regionBottom = (0.5 + region.y / 2) * frameHeight;
                 return location.y < regionBottom;
             }
         }
@@ -0,0 +1,231 @@
+#include "imaging.hpp"
+#include <cmath>
+
+using namespace tsw::imaging;
+
+OfficerTrackManager::OfficerTrackManager()
+{
+    _nextId = 1;
+    Reset();
+}
+
+void OfficerTrackManager::Update(vector<OfficerInferenceBox>& boxes)
+{
+    static Counter& createdCounter = MetricsRegistry::Instance().GetCounter("tracks.created");
+
+    // Everybody is one frame older and missed until they get a box.
+    for(OfficerTrack& track : _tracks)
+    {
+        if(track.active)
+        {
+            track.age++;
+            track.misses++;
+        }
+    }
+
+    // Greedy matching, best pair first. There are only a handful of people in a frame so this is plenty fast.
+    vector<bool> boxMatched(boxes.size(), false);
+    array<bool, MAX_OFFICER_TRACKS> trackMatched;
+    trackMatched.fill(false);
+    while(true)
+    {
+        double bestScore = 0;
+        int bestTrack = -1;
+        int bestBox = -1;
+        for(int t = 0; t < MAX_OFFICER_TRACKS; t++)
+        {
+            if(!_tracks[t].active || trackMatched[t])
+            {
+                continue;
+            }
+
+            for(size_t b = 0; b < boxes.size(); b++)
+            {
+                double score = boxMatched[b] ? 0 : MatchScore(_tracks[t].box, boxes[b]);
+                if(score > bestScore)
+                {
+                    bestScore = score;
+                    bestTrack = t;
+                    bestBox = b;
+                }
+            }
+        }
+
+        if(bestTrack < 0)
+        {
+            break;
+        }
+
+        OfficerTrack& track = _tracks[bestTrack];
+        track.box = boxes[bestBox];
+        track.hits++;
+        track.misses = 0;
+        trackMatched[bestTrack] = true;
+        boxMatched[bestBox] = true;
+    }
+
+    // Drop the ones we haven't seen in a while.
+    for(OfficerTrack& track : _tracks)
+    {
+        if(track.active && track.misses > TRACK_MAX_MISSES)
+        {
+            Log("Officer track " + to_string(track.id) + " lost", Officers);
+            track.active = false;
+        }
+    }
+
+    // Anything left over is somebody new.
+    for(size_t b = 0; b < boxes.size(); b++)
+    {
+        if(boxMatched[b])
+        {
+            continue;
+        }
+
+        // Every slot already has somebody from this frame, so there is nowhere to put them.
+        OfficerTrack* track = GetFreeSlot();
+        if(!track)
+        {
+            break;
+        }
+        track->active = true;
+        track->id = _nextId++;
+        track->box = boxes[b];
+        track->age = 1;
+        track->hits = 1;
+        track->misses = 0;
+        track->confirmed = false;
+        track->colorScore = 0;
+        track->verifiedAge = 0;
+        track->verifiedUs = -1;
+        createdCounter.Add();
+    }
+}
+
+OfficerTrack* OfficerTrackManager::SelectTarget()
+{
+    // Stick with who we were following, even if somebody else looks a little better.
+    OfficerTrack* target = FindTrack(_targetId);
+    if(target && target->confirmed)
+    {
+        // If they just dropped out for a frame, wait for them instead of jumping to someone else.
+        return target->misses == 0 ? target : nullptr;
+    }
+
+    // Otherwise go with whoever we have been seeing the longest and the most consistently.
+    OfficerTrack* best = nullptr;
+    double bestScore = 0;
+    for(OfficerTrack& track : _tracks)
+    {
+        if(!track.active || !track.confirmed || track.misses != 0)
+        {
+            continue;
+        }
+
+        double score = track.hits * (track.hits / (double)track.age);
+        if(!best || score > bestScore || (score == bestScore && track.box.confidence > best->box.confidence))
+        {
+            best = &track;
+            bestScore = score;
+        }
+    }
+
+    if(best)
+    {
+        Log("Following officer track " + to_string(best->id), Officers);
+        _targetId = best->id;
+    }
+
+    return best;
+}
+
+array<OfficerTrack, MAX_OFFICER_TRACKS>& OfficerTrackManager::GetTracks()
+{
+    return _tracks;
+}
+
+void OfficerTrackManager::Reset()
+{
+    for(OfficerTrack& track : _tracks)
+    {
+        track.active = false;
+    }
+
+    _targetId = 0;
+}
+
+OfficerTrack* OfficerTrackManager::FindTrack(int id)
+{
+    for(OfficerTrack& track : _tracks)
+    {
+        if(track.active && track.id == id)
+        {
+            return &track;
+        }
+    }
+
+    return nullptr;
+}
+
+OfficerTrack* OfficerTrackManager::GetFreeSlot()
+{
+    // When it is full, kick out whoever we care about least. Never the target though.
+    // Nor anybody seen this frame, that would throw away a match (or a new track) we just made.
+    OfficerTrack* worst = nullptr;
+    for(OfficerTrack& track : _tracks)
+    {
+        if(!track.active)
+        {
+            return &track;
+        }
+
+        if(track.id == _targetId || track.misses == 0)
+        {
+            continue;
+        }
+
+        if(!worst || track.confirmed < worst->confirmed || (track.confirmed == worst->confirmed && track.hits - track.misses < worst->hits - worst->misses))
+        {
+            worst = &track;
+        }
+    }
+
+    return worst;
+}
+
+double OfficerTrackManager::IoU(OfficerInferenceBox& first, OfficerInferenceBox& second)
+{
+    double overlapWidth = min(first.bottomRightX, second.bottomRightX) - max(first.topLeftX, second.topLeftX);
+    double overlapHeight = min(first.bottomRightY, second.bottomRightY) - max(first.topLeftY, second.topLeftY);
+    if(overlapWidth <= 0 || overlapHeight <= 0)
+    {
+        return 0;
+    }
+
+    double firstArea = (first.bottomRightX - first.topLeftX) * (double)(first.bottomRightY - first.topLeftY);
+    double secondArea = (second.bottomRightX - second.topLeftX) * (double)(second.bottomRightY - second.topLeftY);
+    double overlap = overlapWidth * overlapHeight;
+    return overlap / (firstArea + secondArea - overlap);
+}
+
+double OfficerTrackManager::MatchScore(OfficerInferenceBox& trackBox, OfficerInferenceBox& box)
+{
+    double iou = IoU(trackBox, box);
+    if(iou >= TRACK_MIN_IOU)
+    {
+        return iou;
+    }
+
+    // Fast movers (or a moving camera) don't overlap much, so fall back on how far the centers moved.
+    // This always scores below a real overlap match.
+    double dx = (box.topLeftX + box.bottomRightX - trackBox.topLeftX - trackBox.bottomRightX) / 2.0;
+    double dy = (box.topLeftY + box.bottomRightY - trackBox.topLeftY - trackBox.bottomRightY) / 2.0;
+    double maxDistance = max(trackBox.bottomRightX - trackBox.topLeftX, trackBox.bottomRightY - trackBox.topLeftY);
+    double distance = hypot(dx, dy);
+    if(maxDistance <= 0 || distance >= maxDistance)
+    {
+        return 0;
+    }
+
+    return TRACK_MIN_IOU * (1 - distance / maxDistance);
+}
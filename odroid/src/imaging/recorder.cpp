@@ -17,6 +17,7 @@ Recorder::Recorder(Size frameSize, double fps)
     _fps = fps;
 	_isRecording = false;
     _frameBufferLock.Name = "REC";
+    Name = "recorder";
 }
 
 void Recorder::StartRecording(string fileName)
@@ -35,7 +36,7 @@ void Recorder::StartRecording(string fileName)
         }
 
         // Start the thread that actually saves these frames.
-        _recordFuture = async(launch::async, [this]()
+        _recordFuture = Executor::Instance().Submit(ENCODING_GROUP, [this]()
         {
             Record();
         });
@@ -47,6 +48,7 @@ void Recorder::StopRecording()
     if(IsRecording())
     {
         _isRecording = false;
+        _frameSignal.Notify();
 
         // Wait for the recording thread to finish. (This could take a while!)
         _recordFuture.wait();
@@ -61,7 +63,7 @@ bool Recorder::IsRecording()
     return _isRecording;
 }
 
-void Recorder::AddFrame(Mat frame)
+void Recorder::AddFrame(Mat frame, int64_t frameIndex, int64_t timeUs)
 {
     // In case this gets invoked after we stop recording.
     if(IsRecording())
@@ -70,14 +72,27 @@ void Recorder::AddFrame(Mat frame)
         // Another thread will take care of actually recording it.
         // We do this so that images can be acquired as fast as possible.
         _frameBufferLock.Lock("Add Image");
-        _frameBuffer.push(frame);
+        BufferedFrame bufferedFrame;
+        bufferedFrame.frame = frame;
+        bufferedFrame.frameIndex = frameIndex;
+        bufferedFrame.timeUs = timeUs;
+        _frameBuffer.push(bufferedFrame);
         _frameBufferLock.Unlock("Add Image");
+        _frameSignal.Notify();
     }
 }
 
 void Recorder::Record()
 {
+    // Each recorder gets its own metrics so we can tell the footage and filter apart.
+    MetricsRegistry& metrics = MetricsRegistry::Instance();
+    Gauge& backlogGauge = metrics.GetGauge(Name + ".backlog");
+    Counter& framesCounter = metrics.GetCounter(Name + ".frames");
+    LatencyHistogram& encodeHistogram = metrics.GetHistogram(Name + ".encode_us");
+
 	size_t frameIndex = 0;
+    int64_t startUs = -1;
+    int64_t slotsWritten = 0;
     while(IsRecording())
     {
         // Put all of the frames that are in the buffer in the video.
@@ -85,6 +100,7 @@ void Recorder::Record()
         {
             _frameBufferLock.Lock("Record");
             size_t framesLeft = _frameBuffer.size();
+            backlogGauge.Set(framesLeft);
             Log(to_string(framesLeft) + " frames found in buffer", Recording);
             if(framesLeft <= 0)
             {
@@ -94,16 +110,51 @@ void Recorder::Record()
             }
 
             // Access and remove the next frame.
-            Mat image = _frameBuffer.front();
+            BufferedFrame bufferedFrame = _frameBuffer.front();
             _frameBuffer.pop();
             _frameBufferLock.Unlock("Record");
 
             // Put this frame in the video.
-            _aviWriter.write(image);
+            {
+                LatencyTimer encodeTimer(encodeHistogram);
+                TraceSpan encodeSpan("Encode", bufferedFrame.frameIndex);
+                // The camera's readout can change size mid recording, but the video can't.
+                if(bufferedFrame.frame.size() != _frameSize)
+                {
+                    resize(bufferedFrame.frame, bufferedFrame.frame, _frameSize);
+                }
+
+                // The video plays back at one rate, but the governor moves the camera's around.
+                // So each frame fills however many of the video's slots its time covers, which keeps playback in real time.
+                int64_t copies = 1;
+                if(bufferedFrame.timeUs >= 0)
+                {
+                    if(startUs < 0)
+                    {
+                        startUs = bufferedFrame.timeUs;
+                    }
+
+                    int64_t slot = llround((bufferedFrame.timeUs - startUs) * _fps / 1000000);
+                    if(slot - slotsWritten > _fps)
+                    {
+                        // A gap that long is the camera coming back from a reconnect, no point filling it with the same frame.
+                        startUs = bufferedFrame.timeUs - (int64_t)(slotsWritten * 1000000 / _fps);
+                        slot = slotsWritten;
+                    }
+                    copies = max<int64_t>(slot + 1 - slotsWritten, 0);
+                }
+
+                for(int64_t i = 0; i < copies; i++)
+                {
+                    _aviWriter.write(bufferedFrame.frame);
+                }
+                slotsWritten += copies;
+            }
+            framesCounter.Add();
             Log("Frame " + to_string(frameIndex++) + " recorded", Recording);
         }
 
-        // Wait a bit before recording more frames.
-        usleep(100000);
+        // Sleep until a new frame shows up (or we get stopped).
+        _frameSignal.Wait();
     }
 }
@@ -1,4 +1,5 @@
 #include "imaging.hpp"
+#include <cmath>
 
 using namespace tsw::imaging;
 using namespace cv;
@@ -9,71 +10,125 @@ SmartOfficerLocator::SmartOfficerLocator(int16_t officerClassId) : OfficerLocato
     MaxHSV[1] = 255;
     MaxHSV[2] = 255;
     OfficerThreshold = 0.15;
+
+    // Hang on to a color score for about half a second of a box that isn't changing much.
+    ColorCache.maxFrames = 15;
+    ColorCache.maxTime = 500;
+    ColorCache.minIoU = 0.7;
+    ColorCache.maxConfidenceChange = 0.2;
 }
 
 OfficerInferenceBox* SmartOfficerLocator::GetDesiredOfficerBox(vector<OfficerInferenceBox> officerBoxes, ImagePtr image)
 {
+    // This just wraps the camera's buffer, nothing gets copied.
     unsigned char* data = (unsigned char*)image->GetData();
     Mat m(image->GetHeight(), image->GetWidth(), CV_8UC3, data);
+    return GetDesiredOfficerBox(officerBoxes, m);
+}
+
+OfficerInferenceBox* SmartOfficerLocator::GetDesiredOfficerBox(vector<OfficerInferenceBox> officerBoxes, Mat m)
+{
+    // Line the boxes up with who we saw last frame.
+    Tracks.Update(officerBoxes);
 
-    OfficerInferenceBox* bestBox = nullptr;
-    for(int i = 0; i < officerBoxes.size(); i++)
+    // The color check is the expensive part, so reuse the last score as long as the box hasn't really changed.
+    static Counter& hitsCounter = MetricsRegistry::Instance().GetCounter("locator.color_cache_hits");
+    static Counter& missesCounter = MetricsRegistry::Instance().GetCounter("locator.color_cache_misses");
+    int64_t nowUs = GetMonotonicTimeUs();
+    bool refreshedExpired = false;
+    for(OfficerTrack& track : Tracks.GetTracks())
     {
-        OfficerInferenceBox curBox = officerBoxes[i];
-        
-        // Determine how big the roi is.
-        Log("ROI: Top-Left = (" + to_string(curBox.topLeftX) + ", " + to_string(curBox.topLeftY) + ") Bottom-Right = (" + to_string(curBox.bottomRightX) + ", " + to_string(curBox.bottomRightY) + ")", OpenCV);
-        Size roiSize(curBox.bottomRightX - curBox.topLeftX, curBox.bottomRightY - curBox.topLeftY);
-        
-        Log("Creating ROI matrix", OpenCV);
-        Mat roi(roiSize, CV_8UC3);
-        Log("ROI matrix created", OpenCV);
-
-        // This places just the bounding box in a seperate mat.
-        m(Rect(Point(curBox.topLeftX, curBox.topLeftY), roiSize)).copyTo(roi(Rect(Point(0, 0), roiSize)));
-
-        // Now we gotta convert this guy to HSV.
-        cvtColor(roi, roi, COLOR_RGB2HSV);
-
-        // Now we can see how much of the image is in range of out threshold.
-        Mat hsvThreshold;
-        inRange(roi, MinHSV, MaxHSV, hsvThreshold);
-
-        // At least 30% of the box has to be in the threshold for us to consider it.
-        int numInThreshold = 0;
-        int total = 0;
-        for(int row = 0; row < hsvThreshold.rows; row += 10)
+        if(!track.active || track.misses != 0)
         {
-            uchar* rowPtr = hsvThreshold.ptr(row);
-            for(int col = 0; col < hsvThreshold.cols; col += 10)
-            {
-                if(rowPtr[col] > 0)
-                {
-                    numInThreshold++;
-                }
+            continue;
+        }
 
-                total++;
-            }
+        // Scores that just got too old are refreshed one per frame, so they don't all land on the same frame.
+        bool isExpired = false;
+        if(IsCachedScoreValid(track, nowUs, &isExpired) || (isExpired && refreshedExpired))
+        {
+            hitsCounter.Add();
+            continue;
         }
 
-        float thresholdProp = total != 0 ? numInThreshold / (float)(total) : 0;
-        Log("Officer threshold value of " + to_string(thresholdProp), Officers);
-        if(thresholdProp >= OfficerThreshold)
+        refreshedExpired |= isExpired;
+        missesCounter.Add();
+        track.colorScore = GetColorScore(track.box, m);
+        track.verifiedBox = track.box;
+        track.verifiedAge = track.age;
+        track.verifiedUs = nowUs;
+
+        bool isOfficer = track.colorScore >= OfficerThreshold;
+        if(isOfficer != track.confirmed)
         {
-            // This box has enough of the color. Now let's compare it.
-            if(!bestBox || officerBoxes[i].confidence > bestBox->confidence)
-            {
-                delete bestBox;
-                bestBox = new OfficerInferenceBox(officerBoxes[i]);
-            }
+            Log("Officer track " + to_string(track.id) + (isOfficer ? " confirmed" : " no longer looks like an officer"), Officers);
+            track.confirmed = isOfficer;
         }
     }
 
-    // If our best box is still null, we didn't find an officer.
-    if(bestBox)
+    OfficerTrack* target = Tracks.SelectTarget();
+    if(!target)
+    {
+        // We didn't find an officer.
+        return nullptr;
+    }
+
+    Log("Officer Confidence: " + to_string(target->box.confidence), Officers);
+    return new OfficerInferenceBox(target->box);
+}
+
+bool SmartOfficerLocator::IsCachedScoreValid(OfficerTrack& track, int64_t nowUs, bool* isExpired)
+{
+    // Never checked, or the box moved/changed enough that it could be somebody else now.
+    if(track.verifiedUs < 0 || OfficerTrackManager::IoU(track.box, track.verifiedBox) < ColorCache.minIoU
+        || fabs(track.box.confidence - track.verifiedBox.confidence) > ColorCache.maxConfidenceChange)
+    {
+        return false;
+    }
+
+    // Still the same box, it has just been a while.
+    *isExpired = track.age - track.verifiedAge >= ColorCache.maxFrames || nowUs - track.verifiedUs >= ColorCache.maxTime * 1000LL;
+    return !*isExpired;
+}
+
+float SmartOfficerLocator::GetColorScore(OfficerInferenceBox curBox, Mat m)
+{
+    // Determine how big the roi is.
+    Log("ROI: Top-Left = (" + to_string(curBox.topLeftX) + ", " + to_string(curBox.topLeftY) + ") Bottom-Right = (" + to_string(curBox.bottomRightX) + ", " + to_string(curBox.bottomRightY) + ")", OpenCV);
+    Size roiSize(curBox.bottomRightX - curBox.topLeftX, curBox.bottomRightY - curBox.topLeftY);
+    
+    Log("Creating ROI matrix", OpenCV);
+    Mat roi(roiSize, CV_8UC3);
+    Log("ROI matrix created", OpenCV);
+
+    // This places just the bounding box in a seperate mat.
+    m(Rect(Point(curBox.topLeftX, curBox.topLeftY), roiSize)).copyTo(roi(Rect(Point(0, 0), roiSize)));
+
+    // Now we gotta convert this guy to HSV.
+    cvtColor(roi, roi, COLOR_RGB2HSV);
+
+    // Now we can see how much of the image is in range of out threshold.
+    Mat hsvThreshold;
+    inRange(roi, MinHSV, MaxHSV, hsvThreshold);
+
+    // At least 30% of the box has to be in the threshold for us to consider it.
+    int numInThreshold = 0;
+    int total = 0;
+    for(int row = 0; row < hsvThreshold.rows; row += 10)
     {
-        Log("Officer Confidence: " + to_string(bestBox->confidence), Officers);
+        uchar* rowPtr = hsvThreshold.ptr(row);
+        for(int col = 0; col < hsvThreshold.cols; col += 10)
+        {
+            if(rowPtr[col] > 0)
+            {
+                numInThreshold++;
+            }
+
+            total++;
+        }
     }
 
-    return bestBox;
+    float thresholdProp = total != 0 ? numInThreshold / (float)(total) : 0;
+    Log("Officer threshold value of " + to_string(thresholdProp), Officers);
+    return thresholdProp;
 }
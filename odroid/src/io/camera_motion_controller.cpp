@@ -1,6 +1,8 @@
 #include "io.hpp"
 #include "imaging.hpp"
 #include <functional>
+#include <cmath>
+#include <chrono>
 
 using namespace tsw::io;
 using namespace tsw::imaging;
@@ -21,15 +23,34 @@ CameraMotionController::CameraMotionController(MotorController& motorController)
     HorizontalFov = 44.8;
     VerticalFov = 34.6;
 
+    // By default, guidance just runs whenever a frame shows up.
+    GuidanceRate = 0;
+    UseSearchTrajectory = false;
+    ArmedStandby = false;
+    _isArming = false;
+    _isArmed = false;
+    _areMotorsActive = false;
+    _isControlLoopRunning = false;
+    _hasPendingTarget = false;
+    _lastFrameTimeUs = 0;
+
+    // Frames get used no matter what the motors were doing, same as always.
+    MotionGating.enabled = false;
+    MotionGating.maxSlewRate = 0;
+    MotionGating.compensate = false;
+
     // By default, we did not find an officer.
     ResetSearchState();
     _isGuidanceInitialized = false;
+    _isGuidancePaused = false;
 }
 
 void CameraMotionController::ResetSearchState()
 {
     _lastSeen.foundOfficer = false;
+    _hasLastSeenAngles = false;
     _searchState = NotSearching;
+    _isOfficerVisible = false;
 }
 
 bool CameraMotionController::IsGuidanceInitialized()
@@ -37,20 +58,105 @@ bool CameraMotionController::IsGuidanceInitialized()
     return _isGuidanceInitialized;
 }
 
-void CameraMotionController::InitializeGuidance()
+void CameraMotionController::ArmGuidance()
 {
-    if(!IsGuidanceInitialized())
+    if(IsGuidanceInitialized() || _isArming || _isArmed)
     {
-        // Activate the motors.
-        _motorController->Activate();
+        return;
+    }
 
-        // Set the speeds.
-        _motorController->SetSpeeds(MotorSpeeds);
+    // Calibration takes a while, so get it out of the way before anybody asks us to track.
+    Log("Arming motors in the background", Movements);
+    _isArming = true;
+    _armFuture = Executor::Instance().Submit(GUIDANCE_GROUP, [this]()
+    {
+        try
+        {
+            PrepareMotors();
+            _isArmed = true;
+            Log("Motors armed", Movements);
+        }
+        catch(exception& ex)
+        {
+            // Guidance will just try again when it starts.
+            Log("Could not arm the motors: " + string(ex.what()), tsw::utilities::Error | Movements);
+        }
+    });
+}
 
-        // Turn off the leds.
+void CameraMotionController::DisarmGuidance()
+{
+    WaitForArming();
+    if(!IsGuidanceInitialized() && _areMotorsActive)
+    {
+        _motorController->Deactivate();
         _motorController->SetHeadlightsState(0);
+        _areMotorsActive = false;
+        _isArmed = false;
+    }
+}
+
+void CameraMotionController::WaitForArming()
+{
+    if(_isArming)
+    {
+        _armFuture.wait();
+        _isArming = false;
+    }
+}
+
+void CameraMotionController::PrepareMotors()
+{
+    // Activate the motors, unless standby kept them on from last time.
+    bool wasActive = _areMotorsActive;
+    if(!wasActive)
+    {
+        _motorController->Activate();
+        _areMotorsActive = true;
+    }
+
+    // Set the speeds.
+    _motorController->SetSpeeds(MotorSpeeds);
+
+    // Turn off the leds.
+    _motorController->SetHeadlightsState(0);
 
+    // The tracker works in absolute angles, so we need to start from somewhere we know.
+    // Same if they never got recalibrated, they are still wherever we left them.
+    if(Tracker.Config.enabled || wasActive)
+    {
+        GoToHome();
+    }
+}
+
+void CameraMotionController::InitializeGuidance()
+{
+    if(!IsGuidanceInitialized())
+    {
+        static LatencyHistogram& startHistogram = MetricsRegistry::Instance().GetHistogram("guidance.start_us");
+        int64_t startUs = GetMonotonicTimeUs();
+
+        // If standby already got the motors ready, all that is left is to start guiding.
+        WaitForArming();
+        if(_isArmed)
+        {
+            Log("Motors already armed", Movements);
+        }
+        else
+        {
+            PrepareMotors();
+        }
+
+        _isArmed = false;
+        Tracker.Reset();
         _isGuidanceInitialized = true;
+        startHistogram.Record(GetMonotonicTimeUs() - startUs);
+
+        // Everything is ready for commands, so the loop can start sending them.
+        if(GuidanceRate > 0)
+        {
+            StartControlLoop();
+        }
     }
 }
 
@@ -58,30 +164,101 @@ void CameraMotionController::UninitializeGuidance()
 {
     if(IsGuidanceInitialized())
     {
-        // Deactivate the motors.
-        _motorController->Deactivate();
+        // Nobody else can be sending commands while we shut down.
+        StopControlLoop();
+        StopCircling();
+
+        // In standby the motors stay on, so the next start doesn't have to wait on calibration.
+        if(!ArmedStandby)
+        {
+            _motorController->Deactivate();
+            _areMotorsActive = false;
+        }
 
         // Turn off the leds to save some juice.
         _motorController->SetHeadlightsState(0);
 
         _isGuidanceInitialized = false;
         ResetSearchState();
+        Tracker.Reset();
+        _isGuidancePaused = false;
+
+        if(ArmedStandby)
+        {
+            ArmGuidance();
+        }
     }
 }
 
+void CameraMotionController::PauseGuidance()
+{
+    if(IsGuidanceInitialized() && !_isGuidancePaused)
+    {
+        // Whatever we were chasing is old news by the time the camera comes back, so stop where we are.
+        // The live feed checks this on its own thread, so flip it first to keep frames from guiding while we stop.
+        Log("Pausing guidance", Movements);
+        _isGuidancePaused = true;
+        StopControlLoop();
+        StopCircling();
+        _motorController->SendAsyncRelativeMoveCommand(0, 0);
+        _motorController->SetHeadlightsState(0);
+        Tracker.Reset();
+    }
+}
+
+void CameraMotionController::ResumeGuidance()
+{
+    if(_isGuidancePaused)
+    {
+        // Start over like we just got here, the officer could be anywhere now.
+        // Only let the frames back in once the search state is fresh.
+        Log("Resuming guidance", Movements);
+        ResetSearchState();
+        _isGuidancePaused = false;
+        if(GuidanceRate > 0)
+        {
+            StartControlLoop();
+        }
+    }
+}
+
+bool CameraMotionController::IsGuidancePaused()
+{
+    return _isGuidancePaused;
+}
+
 void CameraMotionController::GuideCameraTo(OfficerDirection location)
 {
+    GuideCameraTo(location, GetMonotonicTimeUs());
+}
+
+void CameraMotionController::GuideCameraTo(OfficerDirection location, int64_t frameTimeUs)
+{
+    if(Tracker.Config.enabled)
+    {
+        TrackOfficer(location, frameTimeUs);
+        return;
+    }
+
+    // The frame may have been taken on the way somewhere, so make it look like it was taken from here.
+    if(MotionGating.enabled && MotionGating.compensate)
+    {
+        location = CompensateForMotion(location, frameTimeUs);
+    }
+
     if(location.foundOfficer)
     {
         // Add a reference to where we last saw the officer.
         _lastSeen = location;
+        RememberLastSeenAngles(location, frameTimeUs);
 
         // Reset the officer search state.
-        _searchState = NotSearching;
+        StopCircling();
 
         // Set the headlights to reflect that we see the officer.
         // We may also have to say that we are moving, so hold off on the send.
         unsigned char desiredHeadlights = HEADLIGHTS_OFFICER_VISIBLE;
+        GimbalEstimate pointing = _motorController->EstimateAngles();
 
         // We don't always have to move if we found the officer.
         if(location.shouldMove)
@@ -92,9 +269,15 @@ void CameraMotionController::GuideCameraTo(OfficerDirection location)
             double verticalRotate = -1 * location.movement.y * VerticalFov / 2;
             desiredHeadlights |= HEADLIGHTS_MOVING_TO_OFFICER;
 
+            // If we know where we are, don't go past the bounds.
+            if(pointing.isKnown)
+            {
+                horizontalRotate = ClampPan(pointing.angles.x + horizontalRotate) - pointing.angles.x;
+            }
+
             _motorController->SendAsyncRelativeMoveCommand(horizontalRotate, verticalRotate);
         }
-        else
+        else if(!pointing.isKnown || pointing.isMoving)
         {
             Log("Officer found, halting motors", Movements | Officers);
             _motorController->SendAsyncRelativeMoveCommand(0, 0);
@@ -110,6 +293,208 @@ void CameraMotionController::GuideCameraTo(OfficerDirection location)
     
 }
 
+void CameraMotionController::TrackOfficer(OfficerDirection location, int64_t frameTimeUs)
+{
+    if(location.foundOfficer)
+    {
+        _lastSeen = location;
+        StopCircling();
+
+        // Turn where they are in the frame into where they are to the motors, based on where the motors
+        // were pointing when the frame was taken. If we don't know, where we last told them to go is the best we have.
+        GimbalEstimate pointing = _motorController->EstimateAngles(frameTimeUs);
+        Vector2 officerAngles = ToWorldAngles(location, pointing.isKnown ? pointing.angles : _motorController->GetCommandedAngles());
+        _lastSeenAngles = officerAngles;
+        _hasLastSeenAngles = pointing.isKnown;
+        Vector2 officerSize;
+        officerSize.x = location.size.x * HorizontalFov;
+        officerSize.y = location.size.y * VerticalFov;
+        Tracker.Update(officerAngles, officerSize, frameTimeUs);
+    }
+    else if(!Tracker.Coast())
+    {
+        // Lost them for too long, time to go looking like normal.
+        OfficerSearch();
+        return;
+    }
+
+    _isOfficerVisible = location.foundOfficer;
+    AimAtPrediction();
+}
+
+void CameraMotionController::AimAtPrediction()
+{
+    // Aim for where they will be by the time the motors get there, not where they were when the frame was taken.
+    Vector2 commanded = _motorController->GetCommandedAngles();
+    Vector2 aim = Tracker.Predict(GetMonotonicTimeUs() + Tracker.Config.leadTime * 1000);
+    aim.x = ClampPan(aim.x);
+    unsigned char desiredHeadlights = _isOfficerVisible ? HEADLIGHTS_OFFICER_VISIBLE : 0;
+    if(Tracker.Config.velocityControl)
+    {
+        // Steering is about where they are now, and the commanded angles don't know about the speed limits.
+        GimbalEstimate pointing = _motorController->EstimateAngles();
+        SteerTowards(aim, pointing.isKnown ? pointing.angles : commanded);
+        if(_motorController->GetVelocityTimeLeft() > 0)
+        {
+            desiredHeadlights |= HEADLIGHTS_MOVING_TO_OFFICER;
+        }
+    }
+    else if(hypot(aim.x - commanded.x, aim.y - commanded.y) > Tracker.Config.deadband)
+    {
+        // Small corrections just make the motors twitch, so only move for the big ones.
+        desiredHeadlights |= HEADLIGHTS_MOVING_TO_OFFICER;
+        _motorController->SendAsyncAbsoluteMoveCommand(aim.x, aim.y);
+    }
+
+    _motorController->SetHeadlightsState(desiredHeadlights);
+}
+
+void CameraMotionController::SteerTowards(Vector2 aim, Vector2 pointing)
+{
+    // Match the officer's speed, plus a little extra to close whatever gap is left.
+    // Unless they are past the bounds, then we just wait at the edge.
+    Vector2 rate = Tracker.GetVelocity();
+    if(aim.x <= AngleXBounds.min || aim.x >= AngleXBounds.max)
+    {
+        rate.x = 0;
+    }
+
+    if(hypot(aim.x - pointing.x, aim.y - pointing.y) > Tracker.Config.deadband)
+    {
+        rate.x += Tracker.Config.velocityGain * (aim.x - pointing.x);
+        rate.y += Tracker.Config.velocityGain * (aim.y - pointing.y);
+    }
+
+    // Only send it if it actually changed, or the last one is about to run out.
+    Vector2 lastRate = _motorController->GetCommandedVelocity();
+    bool changed = hypot(rate.x - lastRate.x, rate.y - lastRate.y) > VELOCITY_RESEND_DELTA;
+    bool isMoving = hypot(rate.x, rate.y) > VELOCITY_RESEND_DELTA;
+    bool runningOut = _motorController->GetVelocityTimeLeft() < VELOCITY_TIMEOUT_MS * 1000 / 2;
+    if(changed || (isMoving && runningOut))
+    {
+        _motorController->SendVelocityCommand(rate.x, rate.y, VELOCITY_TIMEOUT_MS);
+    }
+}
+
+void CameraMotionController::SubmitTarget(OfficerDirection location, int64_t frameTimeUs)
+{
+    // Only the newest one matters, if the loop hasn't gotten to the last one it is too old now anyway.
+    lock_guard<mutex> lock(_targetLock);
+    _pendingTarget = location;
+    _pendingFrameTimeUs = frameTimeUs;
+    _pendingSubmitUs = GetMonotonicTimeUs();
+    _hasPendingTarget = true;
+}
+
+bool CameraMotionController::ControlTick()
+{
+    static LatencyHistogram& ackHistogram = MetricsRegistry::Instance().GetHistogram("latency.decision_to_ack_us");
+    static LatencyHistogram& glassToAckHistogram = MetricsRegistry::Instance().GetHistogram("latency.glass_to_ack_us");
+
+    OfficerDirection target;
+    int64_t submitUs;
+    bool hasTarget;
+    {
+        lock_guard<mutex> lock(_targetLock);
+        hasTarget = _hasPendingTarget;
+        target = _pendingTarget;
+        submitUs = _pendingSubmitUs;
+        _hasPendingTarget = false;
+        if(hasTarget)
+        {
+            _lastFrameTimeUs = _pendingFrameTimeUs;
+        }
+    }
+
+    TraceSpan guidanceSpan("Guidance");
+    uint lastSequence = _motorController->GetLastCommand().sequence;
+    if(hasTarget)
+    {
+        GuideCameraTo(target, _lastFrameTimeUs);
+    }
+    else if(Tracker.Config.enabled && Tracker.HasTrack())
+    {
+        // No new frame yet, but the officer kept moving, so keep up with them.
+        AimAtPrediction();
+    }
+
+    // Guidance waits on the acks, so once we are back the motors have the command.
+    bool commandIssued = _motorController->GetLastCommand().sequence != lastSequence;
+    if(commandIssued)
+    {
+        int64_t ackUs = GetMonotonicTimeUs();
+        if(hasTarget)
+        {
+            ackHistogram.Record(ackUs - submitUs);
+        }
+        glassToAckHistogram.Record(ackUs - _lastFrameTimeUs);
+    }
+
+    return commandIssued;
+}
+
+bool CameraMotionController::IsControlLoopRunning()
+{
+    return _isControlLoopRunning;
+}
+
+void CameraMotionController::StartControlLoop()
+{
+    if(!IsControlLoopRunning())
+    {
+        {
+            lock_guard<mutex> lock(_targetLock);
+            _hasPendingTarget = false;
+        }
+
+        _isControlLoopRunning = true;
+        _controlLoopFuture = Executor::Instance().Submit(GUIDANCE_GROUP, [this]()
+        {
+            ControlLoop();
+        });
+    }
+}
+
+void CameraMotionController::StopControlLoop()
+{
+    if(IsControlLoopRunning())
+    {
+        _isControlLoopRunning = false;
+        _controlLoopFuture.wait();
+    }
+}
+
+void CameraMotionController::ControlLoop()
+{
+    static LatencyHistogram& latenessHistogram = MetricsRegistry::Instance().GetHistogram("guidance.tick_lateness_us");
+    static Counter& overrunCounter = MetricsRegistry::Instance().GetCounter("guidance.overruns");
+    Log("Guidance running at " + to_string(GuidanceRate) + "Hz", Movements);
+
+    // The ticks sleep on the wall clock, so the schedule has to be kept on it too.
+    // The simulator doesn't run this loop, it calls ControlTick itself whenever its own time says to.
+    chrono::microseconds period(1000000 / GuidanceRate);
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + period;
+    while(_isControlLoopRunning)
+    {
+        ControlTick();
+
+        chrono::steady_clock::time_point now = chrono::steady_clock::now();
+        if(now > deadline)
+        {
+            // Blew through the deadline, probably waiting on an ack. Start the schedule over instead of
+            // firing off a bunch of ticks back to back to catch up.
+            overrunCounter.Add();
+            latenessHistogram.Record(chrono::duration_cast<chrono::microseconds>(now - deadline).count());
+            deadline = now + period;
+            continue;
+        }
+
+        this_thread::sleep_until(deadline);
+        latenessHistogram.Record(chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - deadline).count());
+        deadline += period;
+    }
+}
+
 void CameraMotionController::OfficerSearch()
 {
     DeviceMessage temp;
@@ -125,8 +510,7 @@ void CameraMotionController::OfficerSearch()
             if(_motorController->TryReadMessage(&temp))
             {
                 // We made it, at this point the officer probably is not there, so just go home.
-                _searchState = Circling;
-                MoveToMin();
+                StartCircling();
             }
             break;
 
@@ -144,12 +528,29 @@ void CameraMotionController::CalibrateFOV(int frameWidth, int frameHeight)
     VerticalFov = 34.6 * frameHeight / 1080.0;
 }
 
+MotorCommand CameraMotionController::GetLastMotorCommand()
+{
+    return _motorController->GetLastCommand();
+}
+
 void CameraMotionController::CheckLastSeen()
 {
     _searchState = CheckingLastSeen;
 
+    // If we know where they were, we can go straight there instead of guessing from wherever we are now.
+    if(_lastSeen.foundOfficer && _hasLastSeenAngles)
+    {
+        Log("Checking last seen officer angles for officer", Officers);
+
+        // Assume that they kept going the same way, about as far again.
+        Vector2 target = ToWorldAngles(_lastSeen, _lastSeenAngles);
+        _motorController->SendSyncAbsoluteMoveCommand(ClampPan(target.x), target.y);
+        _motorController->SetHeadlightsState(HEADLIGHTS_MOVING_TO_OFFICER);
+        _lastSeen.foundOfficer = false;
+        _hasLastSeenAngles = false;
+    }
     // See if we actually have a last seen position.
-    if(_lastSeen.foundOfficer)
+    else if(_lastSeen.foundOfficer)
     {
         Log("Checking last seen officer direction for officer", Officers);
 
@@ -167,19 +568,119 @@ void CameraMotionController::CheckLastSeen()
     else
     {
         // We have never seen the officer. Just start circling.
-        _searchState = Circling;
-        MoveToMin();
+        StartCircling();
+    }
+}
+
+bool CameraMotionController::IsSlewing(int64_t frameTimeUs)
+{
+    // This gets asked from the acquisition thread while the control loop may be changing all of it,
+    // so the search state and velocity timeout are atomic, and the odometry has its own lock.
+    // While searching, the whole point is to catch them mid sweep, so every frame counts.
+    if(_searchState != NotSearching)
+    {
+        return false;
+    }
+
+    // Same when we are steering after them. The frames are what keep the velocity coming, and if we skip
+    // them the command times out and the gimbal stutters.
+    if(Tracker.Config.enabled && Tracker.Config.velocityControl && _motorController->GetVelocityTimeLeft() > 0)
+    {
+        return false;
+    }
+
+    // Otherwise, going fast enough to smear the officer across the frame means the box isn't worth much.
+    GimbalEstimate pointing = _motorController->EstimateAngles(frameTimeUs);
+    return pointing.isMoving && hypot(pointing.velocity.x, pointing.velocity.y) > MotionGating.maxSlewRate;
+}
+
+OfficerDirection CameraMotionController::CompensateForMotion(OfficerDirection location, int64_t frameTimeUs)
+{
+    if(!location.foundOfficer)
+    {
+        return location;
+    }
+
+    // Relative moves go from wherever the motors are now, not where they were for the frame.
+    // Only the difference matters here, so this works even when we don't know where they are.
+    GimbalEstimate then = _motorController->EstimateAngles(frameTimeUs);
+    GimbalEstimate now = _motorController->EstimateAngles();
+    location.movement.x += (then.angles.x - now.angles.x) * 2 / HorizontalFov;
+    location.movement.y -= (then.angles.y - now.angles.y) * 2 / VerticalFov;
+    return location;
+}
+
+Vector2 CameraMotionController::ToWorldAngles(OfficerDirection location, Vector2 pointing)
+{
+    // Positive angles point to the left/down, same as the relative moves.
+    Vector2 angles;
+    angles.x = pointing.x + location.movement.x * HorizontalFov / 2;
+    angles.y = pointing.y - location.movement.y * VerticalFov / 2;
+    return angles;
+}
+
+void CameraMotionController::RememberLastSeenAngles(OfficerDirection location, int64_t frameTimeUs)
+{
+    GimbalEstimate pointing = _motorController->EstimateAngles(frameTimeUs);
+    _hasLastSeenAngles = pointing.isKnown;
+    if(pointing.isKnown)
+    {
+        _lastSeenAngles = ToWorldAngles(location, pointing.angles);
     }
 }
 
+double CameraMotionController::ClampPan(double angle)
+{
+    return max((double)AngleXBounds.min, min((double)AngleXBounds.max, angle));
+}
+
 void CameraMotionController::GoToHome()
 {
     Log("Going to home position", Movements);
     _motorController->SendSyncAbsoluteMoveCommand(HomeAngles.x, HomeAngles.y);
 }
 
+void CameraMotionController::StartCircling()
+{
+    _searchState = Circling;
+    if(!UseSearchTrajectory)
+    {
+        MoveToMin();
+        return;
+    }
+
+    // Hand the whole sweep to the motors so it doesn't have to wait on us between legs.
+    Log("Starting search sweep", Movements | Officers);
+    TrajectoryWaypoint minWaypoint;
+    minWaypoint.angles.x = AngleXBounds.min;
+    minWaypoint.angles.y = HomeAngles.y;
+    minWaypoint.dwell = SEARCH_DWELL_MS;
+    TrajectoryWaypoint maxWaypoint = minWaypoint;
+    maxWaypoint.angles.x = AngleXBounds.max;
+    _motorController->UploadTrajectory({ minWaypoint, maxWaypoint });
+    _motorController->ExecuteTrajectory(0);
+    _motorController->SetHeadlightsState(HEADLIGHTS_MOVING_TO_OFFICER);
+}
+
+void CameraMotionController::StopCircling()
+{
+    // The sweep keeps going on the motors until we tell it otherwise.
+    if(_searchState == Circling && UseSearchTrajectory)
+    {
+        _motorController->AbortTrajectory();
+    }
+
+    _searchState = NotSearching;
+}
+
 void CameraMotionController::Circle()
 {
+    // The motors are running the sweep themselves.
+    if(UseSearchTrajectory)
+    {
+        return;
+    }
+
     DeviceMessage response;
     if(_motorController->TryReadMessage(&response))
     {
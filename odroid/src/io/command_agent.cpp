@@ -16,7 +16,33 @@ Command* CommandAgent::ReadCommand(Device device)
 
     // Grab a message from the device serial port.
     DeviceMessage message = _commandPort->ReadFromDevice(device);
+    Command* c = ParseCommand(message);
 
+    Log("Command read from " + to_string(device), DeviceSerial);
+
+    return c;
+}
+
+bool CommandAgent::TryReadCommand(Device device, Command** readCommand)
+{
+    DeviceMessage message;
+    if(_commandPort->TryReadFromDevice(device, &message))
+    {
+        *readCommand = ParseCommand(message);
+        Log("Command read from " + to_string(device), DeviceSerial);
+        return true;
+    }
+
+    return false;
+}
+
+EventSignal& CommandAgent::GetCommandSignal(Device device)
+{
+    return _commandPort->GetMessageSignal(device);
+}
+
+Command* CommandAgent::ParseCommand(DeviceMessage message)
+{
     // Bits 0-3 from the first byte will tell us what the command is.
     CommandAction action = (CommandAction)(message.bytes[0] & 0x0f);
 
@@ -25,9 +51,6 @@ Command* CommandAgent::ReadCommand(Device device)
     Command* c = new Command();
     c->action = action;
     c->args = message.bytes;
-
-    Log("Command read from " + to_string(device), DeviceSerial);
-
     return c;
 }
 
@@ -71,20 +94,12 @@ bool CommandAgent::TryReadResponse(Device device, vector<unsigned char>* readRes
 
 vector<unsigned char> CommandAgent::ReadResponse(Device device)
 {
-    Log("Reading response from " + device, DeviceSerial);
-    vector<unsigned char> response;
-    while(true)
-    {
-        if(TryReadResponse(device, &response))
-        {
-            // A response was read. Return it.
-            Log("Response read from " + device, DeviceSerial);
-            return response;
-        }
-
-        // Sleep a bit before trying again.
-        usleep(100000);
-    }
+    Log("Reading response from " + to_string(device), DeviceSerial);
+
+    // The port will block until the device actually sends us something.
+    DeviceMessage message = _commandPort->ReadFromDevice(device);
+    Log("Response read from " + to_string(device), DeviceSerial);
+    return message.bytes;
 }
 
 CommandAgent::~CommandAgent()
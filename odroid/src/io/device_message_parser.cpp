@@ -0,0 +1,51 @@
+#include "io.hpp"
+
+using namespace tsw::io;
+using namespace std;
+
+DeviceMessageParser::DeviceMessageParser()
+{
+    _currentDevice = Motors;
+    _bytesForCurrent = 0;
+}
+
+bool DeviceMessageParser::Push(unsigned char byte, DeviceMessage* message)
+{
+    // Determine where this byte came from.
+    if(!_bytesForCurrent)
+    {
+        _currentDevice = (Device)(byte >> 7);
+
+        // Bits 4-6 will tell us how many extra bytes are coming from this device.
+        _bytesForCurrent = 1 + ((byte & 0b01110000) >> 4);
+    }
+
+    // Add this byte to the list.
+    _currentMessage.push_back(byte);
+    _bytesForCurrent--;
+
+    // See if we reached the end of the message.
+    if(_bytesForCurrent)
+    {
+        return false;
+    }
+
+    message->device = _currentDevice;
+    message->bytes = _currentMessage;
+    _currentMessage.clear();
+    return true;
+}
+
+vector<unsigned char> DeviceMessageParser::Encode(Device device, CommandAction command, vector<unsigned char> data)
+{
+    // Because we only have 3 bits for extra byte count, we cannot have more than 7 bytes.
+    if(data.size() > 7)
+    {
+        throw runtime_error("Cannot send more than 7 bytes as arguments to device.");
+    }
+
+    // Create the header byte and put it in the beginning.
+    unsigned char header = ((unsigned char)device << 7) | data.size() << 4 | command;
+    data.insert(data.begin(), header);
+    return data;
+}
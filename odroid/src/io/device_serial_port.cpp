@@ -13,6 +13,7 @@ DeviceSerialPort::DeviceSerialPort(SerialPort& port)
 {
     _port = &port;
     _bufferLock.Name = "DSP";
+    _isGathering = false;
 }
 
 bool DeviceSerialPort::IsGathering()
@@ -25,7 +26,7 @@ void DeviceSerialPort::StartGathering()
     if(!IsGathering())
     {
         _isGathering = true;
-        _gatherFuture = async(launch::async, [this]()
+        _gatherFuture = Executor::Instance().Submit(SERIAL_GROUP, [this]()
         {
             Gather();
         });
@@ -43,47 +44,34 @@ void DeviceSerialPort::StopGathering()
 
 void DeviceSerialPort::Gather()
 {
-    // We need to keep track of which device we are reading from.
-    Device currentDevice;
-    int bytesForCurrent = 0;
-    vector<unsigned char> currentMessage;
+    Counter& bytesCounter = MetricsRegistry::Instance().GetCounter("serial.bytes_read");
+    Counter& messagesCounter = MetricsRegistry::Instance().GetCounter("serial.messages");
+    Gauge& bufferedGauge = MetricsRegistry::Instance().GetGauge("serial.buffered_messages");
 
     while(IsGathering())
     {
-        // Get a byte from the port.
-        unsigned char b[1];
-        int read = _port->Read(b, 1);
+        // Grab whatever the port has for us, one syscall per burst instead of per byte.
+        unsigned char bytes[64];
+        int read = _port->Read(bytes, sizeof(bytes));
+        bytesCounter.Add(read);
 
-        // See if we read anything.
-        if(read)
+        for(int i = 0; i < read; i++)
         {
-            // Determine where this byte came from.
-            if(!bytesForCurrent)
-            {
-                currentDevice = (Device)(b[0] >> 7);
+            Log("Read byte: " + SerialPort::ToHex(&bytes[i], 1), DeviceSerial);
 
-                // Bits 4-6 will tell us how many extra bytes are coming from this device.
-                bytesForCurrent = 1 + ((b[0] & 0b01110000) >> 4);
-            }
-            
-            // Add this byte to the list.
-            Log("Read byte from " + to_string((int)currentDevice) + ": " + SerialPort::ToHex(b, 1), DeviceSerial);
-            currentMessage.push_back(b[0]);
-            bytesForCurrent--;
-            
-            // See if we reached the end of the message.
-            if(!bytesForCurrent)
+            // The parser lets us know once it has a whole message.
+            DeviceMessage message;
+            if(_parser.Push(bytes[i], &message))
             {
                 // Add this message to the buffer.
-                DeviceMessage message;
-                message.device = currentDevice;
-                message.bytes = currentMessage;
-
                 _bufferLock.Lock("Add Message");
                 _buffer.push_back(message);
+                bufferedGauge.Set(_buffer.size());
                 _bufferLock.Unlock("Add Message");
+                messagesCounter.Add();
 
-                currentMessage = vector<unsigned char>();
+                // Wake up whoever is waiting on this device.
+                _messageSignals[message.device].Notify();
             }
             
             // We are not sleeping here because if we have nothing to read, then the read will act as a small sleep.
@@ -105,8 +93,8 @@ DeviceMessage DeviceSerialPort::ReadFromDevice(Device device)
             return message;
         }
 
-        // Wait a bit before reading again.
-        usleep(10000);
+        // Sleep until the gatherer tells us something new came in for this device.
+        _messageSignals[device].Wait();
     }
 }
 
@@ -126,21 +114,13 @@ DeviceMessage DeviceSerialPort::ReadFromDevice(Device device, unsigned char head
 void DeviceSerialPort::WriteToDevice(vector<unsigned char> formattedData)
 {
     Log("Writing " + to_string(formattedData.size()) + " bytes to serial", RawSerialContinuous);
+    TraceSpan writeSpan("SerialWrite");
     _port->Write(formattedData.data(), formattedData.size());
 }
 
 void DeviceSerialPort::WriteToDevice(Device device, CommandAction command, vector<unsigned char> data)
 {
-    // Because we only have 3 bits for extra byte count, we cannot have more than 7 bytes.
-    if(data.size() > 7)
-    {
-        throw runtime_error("Cannot send more than 7 bytes as arguments to device.");
-    }
-
-    // Create the header byte and put it in the beginning.
-    unsigned char header = ((unsigned char)device << 7) | data.size() << 4 | command;
-    data.insert(data.begin(), header);
-    WriteToDevice(data);
+    WriteToDevice(DeviceMessageParser::Encode(device, command, data));
 }
 
 void DeviceSerialPort::WriteToDevice(Device device, CommandAction action, unsigned char data)
@@ -168,6 +148,17 @@ bool DeviceSerialPort::TryReadFromDevice(Device device, DeviceMessage* readMessa
             // We can return this message once we remove it from the list and unlock the buffer.
             DeviceMessage found = _buffer[i];
             _buffer.erase(_buffer.begin() + i);
+
+            // The signal only says something arrived, not how many. If there are more left, keep it set for the next reader.
+            for(int j = i; j < _buffer.size(); j++)
+            {
+                if(_buffer[j].device == device)
+                {
+                    _messageSignals[device].Notify();
+                    break;
+                }
+            }
+
             _bufferLock.Unlock("Read Message");
             *readMessage = found;
             return true;
@@ -179,6 +170,11 @@ bool DeviceSerialPort::TryReadFromDevice(Device device, DeviceMessage* readMessa
     return false;
 }
 
+EventSignal& DeviceSerialPort::GetMessageSignal(Device device)
+{
+    return _messageSignals[device];
+}
+
 DeviceSerialPort::~DeviceSerialPort()
 {
     if(IsGathering())
@@ -0,0 +1,304 @@
+#include "io.hpp"
+#include <cmath>
+
+using namespace tsw::io;
+
+GimbalOdometry::GimbalOdometry(MotorConfig panConfig, MotorConfig tiltConfig)
+{
+    _panConfig = panConfig;
+    _tiltConfig = tiltConfig;
+    _newest = 0;
+    _count = 0;
+
+    ByteVector2 speeds;
+    speeds.x = DEFAULT_MOTOR_SPEED;
+    speeds.y = DEFAULT_MOTOR_SPEED;
+    SetSpeeds(speeds, 0);
+
+    // Until we send them somewhere absolute, we have no idea where they are.
+    Forget(0);
+}
+
+void GimbalOdometry::SetSpeeds(ByteVector2 speeds, int64_t timeUs)
+{
+    lock_guard<mutex> lock(_lock);
+    _rates.x = speeds.x / 255.0 * _panConfig.maxSpeed;
+    _rates.y = speeds.y / 255.0 * _tiltConfig.maxSpeed;
+
+    // Whatever they are in the middle of keeps going, just at the new speed.
+    if(_count)
+    {
+        MotionSegment segment = _segments[_newest];
+        GimbalEstimate estimate = Evaluate(segment, timeUs);
+        segment.startUs = timeUs;
+        segment.start = estimate.angles;
+        segment.rates = _rates;
+        Push(segment);
+    }
+}
+
+void GimbalOdometry::MoveTo(Vector2 angles, bool isRelative, int64_t timeUs)
+{
+    lock_guard<mutex> lock(_lock);
+    MotionSegment segment = Begin(Moving, timeUs);
+    segment.target = angles;
+    if(isRelative)
+    {
+        // Relative moves go from wherever they actually are, not where they were headed.
+        segment.target.x += segment.start.x;
+        segment.target.y += segment.start.y;
+    }
+    else
+    {
+        segment.isKnown = true;
+    }
+
+    Push(segment);
+}
+
+void GimbalOdometry::SetVelocity(Vector2 velocity, int64_t timeoutUs, int64_t timeUs)
+{
+    lock_guard<mutex> lock(_lock);
+    MotionSegment segment = Begin(Steering, timeUs);
+    segment.velocity = velocity;
+    segment.endUs = timeUs + timeoutUs;
+    Push(segment);
+}
+
+void GimbalOdometry::FollowTrajectory(vector<TrajectoryWaypoint> waypoints, int loops, int64_t timeUs)
+{
+    lock_guard<mutex> lock(_lock);
+    MotionSegment segment = Begin(waypoints.empty() ? Holding : Following, timeUs);
+    segment.waypoints = waypoints;
+    segment.loops = loops;
+    segment.isKnown = true;
+    Push(segment);
+}
+
+void GimbalOdometry::Hold(int64_t timeUs)
+{
+    lock_guard<mutex> lock(_lock);
+    Push(Begin(Holding, timeUs));
+}
+
+void GimbalOdometry::Arrived(int64_t timeUs)
+{
+    // A success means they made it, so snap to the end of whatever they were doing.
+    lock_guard<mutex> lock(_lock);
+    if(!_count)
+    {
+        return;
+    }
+
+    MotionSegment& current = _segments[_newest];
+    MotionSegment segment = Begin(Holding, timeUs);
+    if(current.type == Moving)
+    {
+        segment.start = current.target;
+    }
+    else if(current.type == Following && current.loops > 0)
+    {
+        segment.start = current.waypoints.back().angles;
+    }
+    else
+    {
+        return;
+    }
+
+    Push(segment);
+}
+
+void GimbalOdometry::Forget(int64_t timeUs)
+{
+    lock_guard<mutex> lock(_lock);
+    MotionSegment segment = Begin(Holding, timeUs);
+    segment.isKnown = false;
+    Push(segment);
+}
+
+GimbalEstimate GimbalOdometry::Estimate(int64_t timeUs)
+{
+    lock_guard<mutex> lock(_lock);
+    MotionSegment* segment = FindSegment(timeUs);
+    if(!segment)
+    {
+        // Older than anything we remember.
+        GimbalEstimate estimate;
+        estimate.angles.x = 0;
+        estimate.angles.y = 0;
+        estimate.velocity.x = 0;
+        estimate.velocity.y = 0;
+        estimate.timeUs = timeUs;
+        estimate.isKnown = false;
+        estimate.isMoving = false;
+        return estimate;
+    }
+
+    return Evaluate(*segment, timeUs);
+}
+
+void GimbalOdometry::Push(MotionSegment segment)
+{
+    // Ring buffer, the oldest motion just falls off the end.
+    _newest = (_newest + 1) % ODOMETRY_HISTORY;
+    _segments[_newest] = segment;
+    _count = min(_count + 1, (size_t)ODOMETRY_HISTORY);
+}
+
+GimbalOdometry::MotionSegment GimbalOdometry::Begin(MotionType type, int64_t timeUs)
+{
+    // Every motion starts from wherever the last one had gotten to.
+    MotionSegment segment;
+    segment.type = type;
+    segment.startUs = timeUs;
+    segment.endUs = 0;
+    segment.rates = _rates;
+    segment.velocity.x = 0;
+    segment.velocity.y = 0;
+    segment.loops = 0;
+    segment.isKnown = false;
+    segment.start.x = 0;
+    segment.start.y = 0;
+    if(_count)
+    {
+        GimbalEstimate estimate = Evaluate(_segments[_newest], timeUs);
+        segment.start = estimate.angles;
+        segment.isKnown = estimate.isKnown;
+    }
+
+    segment.target = segment.start;
+    return segment;
+}
+
+GimbalOdometry::MotionSegment* GimbalOdometry::FindSegment(int64_t timeUs)
+{
+    // Newest first, since that is almost always what people are asking about.
+    for(size_t i = 0; i < _count; i++)
+    {
+        MotionSegment& segment = _segments[(_newest + ODOMETRY_HISTORY - i) % ODOMETRY_HISTORY];
+        if(segment.startUs <= timeUs)
+        {
+            return &segment;
+        }
+    }
+
+    return nullptr;
+}
+
+GimbalEstimate GimbalOdometry::Evaluate(MotionSegment& segment, int64_t timeUs)
+{
+    GimbalEstimate estimate;
+    estimate.timeUs = timeUs;
+    estimate.isKnown = segment.isKnown;
+    estimate.angles = segment.start;
+    estimate.velocity.x = 0;
+    estimate.velocity.y = 0;
+    estimate.isMoving = false;
+    double seconds = max((int64_t)0, timeUs - segment.startUs) / 1000000.0;
+
+    switch(segment.type)
+    {
+        case Holding:
+            break;
+
+        case Moving:
+        {
+            estimate.angles = MoveTowards(segment.start, segment.target, segment.rates, seconds);
+            estimate.isMoving = estimate.angles.x != segment.target.x || estimate.angles.y != segment.target.y;
+            if(estimate.isMoving)
+            {
+                estimate.velocity.x = estimate.angles.x == segment.target.x ? 0 : copysign(segment.rates.x, segment.target.x - segment.start.x);
+                estimate.velocity.y = estimate.angles.y == segment.target.y ? 0 : copysign(segment.rates.y, segment.target.y - segment.start.y);
+            }
+            break;
+        }
+
+        case Steering:
+        {
+            // The motors can't go faster than the speed setting, and they stop once the timeout runs out.
+            double steerSeconds = min(seconds, max((int64_t)0, segment.endUs - segment.startUs) / 1000000.0);
+            Vector2 velocity;
+            velocity.x = max(-segment.rates.x, min(segment.rates.x, segment.velocity.x));
+            velocity.y = max(-segment.rates.y, min(segment.rates.y, segment.velocity.y));
+            estimate.angles.x += velocity.x * steerSeconds;
+            estimate.angles.y += velocity.y * steerSeconds;
+            estimate.isMoving = timeUs < segment.endUs && (velocity.x != 0 || velocity.y != 0);
+            if(estimate.isMoving)
+            {
+                estimate.velocity = velocity;
+            }
+            break;
+        }
+
+        case Following:
+        {
+            // Play the trajectory forward the same way the motors do, a leg at a time.
+            Vector2 angles = segment.start;
+            int loopsLeft = segment.loops;
+            bool firstLoop = true;
+            bool finished = false;
+            while(!finished)
+            {
+                double loopStart = seconds;
+                for(TrajectoryWaypoint& waypoint : segment.waypoints)
+                {
+                    double legSeconds = TimeToReach(angles, waypoint.angles, segment.rates);
+                    if(seconds < legSeconds)
+                    {
+                        angles = MoveTowards(angles, waypoint.angles, segment.rates, seconds);
+                        estimate.isMoving = true;
+                        seconds = 0;
+                        break;
+                    }
+
+                    angles = waypoint.angles;
+                    seconds -= legSeconds + waypoint.dwell / 1000.0;
+                    if(seconds < 0)
+                    {
+                        // Sitting at this one for the dwell.
+                        estimate.isMoving = true;
+                        seconds = 0;
+                        break;
+                    }
+                }
+
+                // Out of time, out of loops, or a trajectory that doesn't take any time at all.
+                finished = seconds <= 0 || (loopsLeft > 0 && --loopsLeft == 0) || seconds == loopStart;
+
+                // Every loop after the first starts from the last waypoint, so they all take the same time.
+                // A sweep that has been going for an hour doesn't need to be replayed one loop at a time.
+                if(!finished && !firstLoop && loopsLeft == 0)
+                {
+                    seconds = fmod(seconds, loopStart - seconds);
+                }
+                firstLoop = false;
+            }
+
+            estimate.angles = angles;
+            break;
+        }
+    }
+
+    return estimate;
+}
+
+Vector2 GimbalOdometry::MoveTowards(Vector2 angles, Vector2 target, Vector2 rates, double seconds)
+{
+    // Each axis goes at its own speed and stops once it gets there.
+    Vector2 result;
+    double dx = target.x - angles.x;
+    double dy = target.y - angles.y;
+    result.x = fabs(dx) <= rates.x * seconds ? target.x : angles.x + copysign(rates.x * seconds, dx);
+    result.y = fabs(dy) <= rates.y * seconds ? target.y : angles.y + copysign(rates.y * seconds, dy);
+    return result;
+}
+
+double GimbalOdometry::TimeToReach(Vector2 angles, Vector2 target, Vector2 rates)
+{
+    // The slower axis decides. Zero speed means never, unless we are already there.
+    double dx = fabs(target.x - angles.x);
+    double dy = fabs(target.y - angles.y);
+    double xSeconds = dx == 0 ? 0 : (rates.x > 0 ? dx / rates.x : INFINITY);
+    double ySeconds = dy == 0 ? 0 : (rates.y > 0 ? dy / rates.y : INFINITY);
+    return max(xSeconds, ySeconds);
+}
@@ -4,12 +4,23 @@
 using namespace tsw::io;
 using namespace tsw::utilities;
 
-MotorController::MotorController(DeviceSerialPort& commandPort, MotorConfig panConfig, MotorConfig tiltConfig)
+MotorController::MotorController(DeviceSerialPort& commandPort, MotorConfig panConfig, MotorConfig tiltConfig) : _odometry(panConfig, tiltConfig)
 {
     _commandPort = &commandPort;
     PanConfig = panConfig;
     TiltConfig = tiltConfig;
     _headlightsState = 0;
+    _lastCommand.sequence = 0;
+    _lastCommand.action = 0;
+    _lastCommand.horizontal = 0;
+    _lastCommand.vertical = 0;
+    _commandedAngles.x = 0;
+    _commandedAngles.y = 0;
+    _commandedVelocity.x = 0;
+    _commandedVelocity.y = 0;
+    _velocityStartUs = 0;
+    _velocityEndUs = 0;
+    _isTrajectoryRunning = false;
 }
 
 void MotorController::SendAsyncRelativeMoveCommand(double horizontal, double vertical)
@@ -40,11 +51,7 @@ void MotorController::SendMoveCommand(CommandAction moveType, double horizontal,
     
     // The vertical bytes go after the horizontal.
     vector<unsigned char> bytes(6);
-    for(int i = 0; i < 3; i++)
-    {
-        bytes[2 - i] = (horizontalMotor >> (i * 8)) & 0xff;
-        bytes[5 - i] = (verticalMotor >> (i * 8)) & 0xff;
-    }
+    PackMotorValues(bytes, 0, horizontalMotor, verticalMotor);
 
     // Now we can send the command to the motor.
     // This is an asynchronous move since we don't really need to know when the motor has moved.
@@ -52,9 +59,145 @@ void MotorController::SendMoveCommand(CommandAction moveType, double horizontal,
     Log("MOVE " + moveName + "\tH:  " + to_string(horizontal) + "  (" + to_string(horizontalMotor) + ")\tV:  " + to_string(vertical) + "  (" + to_string(verticalMotor) + ")", Movements);
     _commandPort->WriteToDevice(Motors, moveType, bytes);
 
+    // Keep track of what we last told the motors so others can see what guidance decided.
+    _lastCommand.sequence++;
+    _lastCommand.action = moveType;
+    _lastCommand.horizontal = horizontal;
+    _lastCommand.vertical = vertical;
+
+    // Any move takes the motors out of velocity mode, and stops a trajectory.
+    SettleVelocity(GetMonotonicTimeUs());
+    _velocityEndUs = 0;
+    _isTrajectoryRunning = false;
+
+    // Keep a running idea of where we have told the motors to end up.
+    if(moveType == RelativeMoveAsynchronous || moveType == RelativeMoveSynchronous)
+    {
+        _commandedAngles.x += horizontal;
+        _commandedAngles.y += vertical;
+    }
+    else
+    {
+        _commandedAngles.x = horizontal;
+        _commandedAngles.y = vertical;
+    }
+
     // Wait for the acknowledge (not the same as a synch response).
     // It is possible that the read response is not an ack but a success/failure from a previous move.
     ReadAcknowledge();
+
+    // Once they have it, they start moving.
+    Vector2 angles;
+    angles.x = horizontal;
+    angles.y = vertical;
+    _odometry.MoveTo(angles, moveType == RelativeMoveAsynchronous || moveType == RelativeMoveSynchronous, GetMonotonicTimeUs());
+}
+
+void MotorController::SendVelocityCommand(double horizontalRate, double verticalRate, int timeout)
+{
+    // The rates go across the same way the relative moves do, just per second.
+    int horizontalMotor = AngleToMotorValue(horizontalRate, PanConfig);
+    int verticalMotor = AngleToMotorValue(verticalRate, TiltConfig);
+    vector<unsigned char> bytes(7);
+    PackMotorValues(bytes, 0, horizontalMotor, verticalMotor);
+
+    // Only one byte left for the timeout, so it goes in coarser units.
+    int timeoutUnits = min(255, max(1, timeout / VELOCITY_TIMEOUT_UNIT_MS));
+    bytes[6] = timeoutUnits;
+
+    Log("VELOCITY\tH:  " + to_string(horizontalRate) + "  (" + to_string(horizontalMotor) + ")\tV:  " + to_string(verticalRate) + "  (" + to_string(verticalMotor) + ")\tTimeout:  " + to_string(timeoutUnits * VELOCITY_TIMEOUT_UNIT_MS), Movements);
+    _commandPort->WriteToDevice(Motors, SetVelocity, bytes);
+
+    _lastCommand.sequence++;
+    _lastCommand.action = SetVelocity;
+    _lastCommand.horizontal = horizontalRate;
+    _lastCommand.vertical = verticalRate;
+
+    // Wherever the last velocity got us is where this one starts from.
+    int64_t nowUs = GetMonotonicTimeUs();
+    _isTrajectoryRunning = false;
+    SettleVelocity(nowUs);
+    _commandedVelocity.x = horizontalRate;
+    _commandedVelocity.y = verticalRate;
+    _velocityStartUs = nowUs;
+    _velocityEndUs = nowUs + timeoutUnits * VELOCITY_TIMEOUT_UNIT_MS * 1000LL;
+
+    ReadAcknowledge();
+    _odometry.SetVelocity(_commandedVelocity, _velocityEndUs - nowUs, GetMonotonicTimeUs());
+}
+
+void MotorController::UploadTrajectory(vector<TrajectoryWaypoint> waypoints)
+{
+    if(waypoints.size() > TRAJECTORY_MAX_WAYPOINTS)
+    {
+        throw runtime_error("Motors can only hold " + to_string(TRAJECTORY_MAX_WAYPOINTS) + " trajectory waypoints.");
+    }
+
+    // Whatever was there before gets thrown out, even if it is running.
+    Log("Uploading trajectory with " + to_string(waypoints.size()) + " waypoints", Movements);
+    SendTrajectoryCommand(TrajectoryClear, vector<unsigned char>());
+    _isTrajectoryRunning = false;
+
+    for(TrajectoryWaypoint& waypoint : waypoints)
+    {
+        vector<unsigned char> angleBytes(6);
+        PackMotorValues(angleBytes, 0, AngleToMotorValue(waypoint.angles.x, PanConfig), AngleToMotorValue(waypoint.angles.y, TiltConfig));
+        SendTrajectoryCommand(TrajectoryAddWaypoint, angleBytes);
+
+        // No dwell is the default, so save the round trip.
+        if(waypoint.dwell > 0)
+        {
+            int dwell = min(0xffff, waypoint.dwell);
+            SendTrajectoryCommand(TrajectorySetDwell, { (unsigned char)(dwell >> 8), (unsigned char)(dwell & 0xff) });
+        }
+    }
+
+    _trajectory = waypoints;
+}
+
+void MotorController::ExecuteTrajectory(unsigned char loops)
+{
+    // Zero loops means keep going until somebody aborts it.
+    Log("Executing trajectory " + (loops ? to_string(loops) + " times" : string("until aborted")), Movements);
+    SendTrajectoryCommand(TrajectoryExecute, { loops });
+    _odometry.FollowTrajectory(_trajectory, loops, GetMonotonicTimeUs());
+
+    _lastCommand.sequence++;
+    _lastCommand.action = Trajectory;
+    _isTrajectoryRunning = true;
+
+    // Can't keep up with where they are anymore, the motors are on their own.
+    SettleVelocity(GetMonotonicTimeUs());
+    _velocityEndUs = 0;
+    if(!_trajectory.empty())
+    {
+        _commandedAngles = _trajectory.back().angles;
+    }
+}
+
+void MotorController::AbortTrajectory()
+{
+    if(_isTrajectoryRunning)
+    {
+        Log("Aborting trajectory", Movements);
+        SendTrajectoryCommand(TrajectoryAbort, vector<unsigned char>());
+        _isTrajectoryRunning = false;
+        _odometry.Hold(GetMonotonicTimeUs());
+        _commandedAngles = _odometry.Estimate(GetMonotonicTimeUs()).angles;
+    }
+}
+
+bool MotorController::IsTrajectoryRunning()
+{
+    return _isTrajectoryRunning;
+}
+
+void MotorController::SendTrajectoryCommand(TrajectoryOpcode opcode, vector<unsigned char> args)
+{
+    // The opcode goes first, then whatever that opcode needs.
+    args.insert(args.begin(), opcode);
+    _commandPort->WriteToDevice(Motors, Trajectory, args);
+    ReadAcknowledge();
 }
 
 unsigned char MotorController::GetHeadlightsState()
@@ -91,6 +234,9 @@ void MotorController::Activate()
 	// We gotta wait for this before starting anything else.
     ReadSuccess();
 
+    // Who knows where calibration left them.
+    _odometry.Forget(GetMonotonicTimeUs());
+
     Log("Motors activated", Movements);
 }
 
@@ -100,13 +246,78 @@ void MotorController::Deactivate()
     _commandPort->WriteToDevice(Motors, tsw::io::Deactivate);
     
     ReadAcknowledge();
+    _odometry.Forget(GetMonotonicTimeUs());
     
     Log("Motors Deactivated", Motors);
 }
 
+MotorCommand MotorController::GetLastCommand()
+{
+    return _lastCommand;
+}
+
+Vector2 MotorController::GetCommandedAngles()
+{
+    // While a velocity is running, where we told them to be keeps moving.
+    Vector2 angles = _commandedAngles;
+    int64_t nowUs = GetMonotonicTimeUs();
+    if(_velocityEndUs > _velocityStartUs)
+    {
+        double seconds = (min(nowUs, _velocityEndUs.load()) - _velocityStartUs) / 1000000.0;
+        angles.x += _commandedVelocity.x * seconds;
+        angles.y += _commandedVelocity.y * seconds;
+    }
+
+    return angles;
+}
+
+Vector2 MotorController::GetCommandedVelocity()
+{
+    // Once the timeout runs out, the motors stop.
+    Vector2 velocity;
+    velocity.x = GetVelocityTimeLeft() > 0 ? _commandedVelocity.x : 0;
+    velocity.y = GetVelocityTimeLeft() > 0 ? _commandedVelocity.y : 0;
+    return velocity;
+}
+
+int64_t MotorController::GetVelocityTimeLeft()
+{
+    return max((int64_t)0, _velocityEndUs - GetMonotonicTimeUs());
+}
+
+void MotorController::SettleVelocity(int64_t nowUs)
+{
+    // Fold however far the velocity has taken us into the commanded angles.
+    _commandedAngles = GetCommandedAngles();
+    _velocityStartUs = nowUs;
+    _commandedVelocity.x = 0;
+    _commandedVelocity.y = 0;
+}
+
 bool MotorController::TryReadMessage(DeviceMessage* message)
 {
-    return _commandPort->TryReadFromDevice(Motors, message);
+    if(!_commandPort->TryReadFromDevice(Motors, message))
+    {
+        return false;
+    }
+
+    // A success means whatever sync move was going has finished.
+    if(!message->bytes.empty() && message->bytes[0] == 0x81)
+    {
+        _odometry.Arrived(GetMonotonicTimeUs());
+    }
+
+    return true;
+}
+
+GimbalEstimate MotorController::EstimateAngles()
+{
+    return EstimateAngles(GetMonotonicTimeUs());
+}
+
+GimbalEstimate MotorController::EstimateAngles(int64_t timeUs)
+{
+    return _odometry.Estimate(timeUs);
 }
 
 void MotorController::SetSpeeds(ByteVector2 speeds)
@@ -122,14 +333,24 @@ void MotorController::SetSpeeds(ByteVector2 speeds)
 
     // They will send an ack when they get it.
     ReadAcknowledge();
+    _odometry.SetSpeeds(speeds, GetMonotonicTimeUs());
 
     Log("Motor speeds set", Movements);
 }
 
 void MotorController::ReadAcknowledge()
 {
+    static LatencyHistogram& ackHistogram = MetricsRegistry::Instance().GetHistogram("motors.ack_us");
+    static Counter& commandsCounter = MetricsRegistry::Instance().GetCounter("motors.commands");
+    commandsCounter.Add();
+
+    // We get called right after the write, so this is pretty much the round trip.
     Log("Waiting for acknowledge from motors", tsw::utilities::Acknowledge);
-    _commandPort->ReadFromDevice(Motors, 0x8f);
+    {
+        LatencyTimer ackTimer(ackHistogram);
+        TraceSpan ackSpan("AckWait");
+        _commandPort->ReadFromDevice(Motors, 0x8f);
+    }
     Log("Acknowledge from motors received", tsw::utilities::Acknowledge);
 }
 
@@ -140,6 +361,16 @@ void MotorController::ReadSuccess()
     Log("Success response from motors read", tsw::utilities::Acknowledge);
 }
 
+void MotorController::PackMotorValues(vector<unsigned char>& bytes, int start, int horizontalMotor, int verticalMotor)
+{
+    // Three big endian bytes each, horizontal first.
+    for(int i = 0; i < 3; i++)
+    {
+        bytes[start + 2 - i] = (horizontalMotor >> (i * 8)) & 0xff;
+        bytes[start + 5 - i] = (verticalMotor >> (i * 8)) & 0xff;
+    }
+}
+
 int MotorController::AngleToMotorValue(double angle, MotorConfig config)
 {
     // Get a value between 0 and 1 for how close to the max angle our given angle is.
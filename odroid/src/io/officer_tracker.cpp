@@ -0,0 +1,112 @@
+#include "io.hpp"
+#include <cmath>
+
+using namespace tsw::io;
+
+OfficerTracker::OfficerTracker()
+{
+    Config.enabled = false;
+    Config.alpha = 0.5;
+    Config.beta = 0.1;
+    Config.leadTime = 0;
+    Config.deadband = 0;
+    Config.maxMisses = 0;
+    Config.velocityControl = false;
+    Config.velocityGain = 0;
+    Reset();
+}
+
+void OfficerTracker::Update(Vector2 angles, Vector2 size, int64_t timeUs)
+{
+    // A frame that isn't newer than the last one (out of order, or the same one twice) has nothing to add.
+    // Starting over on it would throw away the velocity for no reason.
+    if(_hasTrack && timeUs <= _timeUs)
+    {
+        return;
+    }
+
+    if(_hasTrack)
+    {
+        // Compare what we see with where we thought they would be.
+        double dt = (timeUs - _timeUs) / 1000000.0;
+        Vector2 predicted = Predict(timeUs);
+        Vector2 residual;
+        residual.x = angles.x - predicted.x;
+        residual.y = angles.y - predicted.y;
+
+        // Way off from the prediction means this is probably somebody else (or a bad box), so start over on them.
+        double gate = TRACKER_GATE_SIZES * max(_size.x, _size.y);
+        if(hypot(residual.x, residual.y) <= gate)
+        {
+            // Standard alpha-beta. Alpha trusts the measurement, beta lets the error nudge the velocity.
+            _position.x = predicted.x + Config.alpha * residual.x;
+            _position.y = predicted.y + Config.alpha * residual.y;
+            _velocity.x += Config.beta / dt * residual.x;
+            _velocity.y += Config.beta / dt * residual.y;
+            _size.x += Config.alpha * (size.x - _size.x);
+            _size.y += Config.alpha * (size.y - _size.y);
+            _timeUs = timeUs;
+            _misses = 0;
+            return;
+        }
+
+        Log("Officer jumped outside of the tracking gate, starting a new track", Officers);
+    }
+
+    _hasTrack = true;
+    _position = angles;
+    _velocity.x = 0;
+    _velocity.y = 0;
+    _size = size;
+    _timeUs = timeUs;
+    _misses = 0;
+}
+
+bool OfficerTracker::Coast()
+{
+    // Keep going off of the velocity for a few frames in case the camera just missed them.
+    if(_hasTrack && ++_misses > Config.maxMisses)
+    {
+        Log("Officer track lost", Officers);
+        Reset();
+    }
+
+    return _hasTrack;
+}
+
+bool OfficerTracker::HasTrack()
+{
+    return _hasTrack;
+}
+
+Vector2 OfficerTracker::Predict(int64_t timeUs)
+{
+    double dt = (timeUs - _timeUs) / 1000000.0;
+    Vector2 predicted;
+    predicted.x = _position.x + _velocity.x * dt;
+    predicted.y = _position.y + _velocity.y * dt;
+    return predicted;
+}
+
+Vector2 OfficerTracker::GetVelocity()
+{
+    return _velocity;
+}
+
+Vector2 OfficerTracker::GetSize()
+{
+    return _size;
+}
+
+void OfficerTracker::Reset()
+{
+    _hasTrack = false;
+    _position.x = 0;
+    _position.y = 0;
+    _velocity.x = 0;
+    _velocity.y = 0;
+    _size.x = 0;
+    _size.y = 0;
+    _timeUs = 0;
+    _misses = 0;
+}
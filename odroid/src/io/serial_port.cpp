@@ -5,21 +5,29 @@
 #include <termios.h>
 #include <unistd.h>
 #include <iomanip>
+#include <poll.h>
+#include <sys/ioctl.h>
+#include <sys/epoll.h>
+#include <linux/serial.h>
 
 using namespace tsw::io;
 using namespace std;
 
-SerialPort::SerialPort(speed_t baudRate)
+SerialPort::SerialPort(speed_t baudRate, bool lowLatency)
 {
     _port = -1;
+    _epoll = -1;
     _baudRate = baudRate;
+    _lowLatency = lowLatency;
 }
 
 void SerialPort::Open(string devicePath)
 {
     // Attempt to connect to the device.
     Log("Opening serial port on " + devicePath, RawSerialContinuous);
-    int res = open(devicePath.c_str(), O_RDWR);
+    // In low latency mode we never block in read/write, epoll does the waiting for us.
+    int flags = _lowLatency ? O_RDWR | O_NOCTTY | O_NONBLOCK : O_RDWR;
+    int res = open(devicePath.c_str(), flags);
 
     // See if we made a successful connection.
     if(res < 0)
@@ -62,6 +70,12 @@ void SerialPort::Open(string devicePath)
     tty.c_cc[VTIME] = 10;    // Wait for up to .1s (1 deciseconds), returning as soon as any data is received.
     tty.c_cc[VMIN] = 0;
 
+    if(_lowLatency)
+    {
+        // Reads return right away with whatever is there.
+        tty.c_cc[VTIME] = 0;
+    }
+
     // Set in/out baud rate to be 115200
     cfsetispeed(&tty, _baudRate);
     cfsetospeed(&tty, _baudRate);
@@ -73,18 +87,94 @@ void SerialPort::Open(string devicePath)
         throw runtime_error("Could not save device attributes.");
     }
 
+    if(_lowLatency)
+    {
+        EnableLowLatency();
+    }
+
     // Ok now we are good.
     Log("Port opened.", RawSerialContinuous);
 }
 
+void SerialPort::Attach(int fd)
+{
+    // This is for things that are already open and are not really serial ports (like the simulator's socket).
+    // Sockets have no VTIME, so we always have to poll them or reads would block forever.
+    Log("Attaching serial port to " + to_string(fd), RawSerialContinuous);
+    _port = fd;
+    _lowLatency = true;
+    fcntl(_port, F_SETFL, fcntl(_port, F_GETFL) | O_NONBLOCK);
+    EnableLowLatency();
+}
+
+void SerialPort::EnableLowLatency()
+{
+    // Without this, the usb serial driver holds on to bytes for a few ms to batch them up.
+    serial_struct serial;
+    if(ioctl(_port, TIOCGSERIAL, &serial) == 0)
+    {
+        serial.flags |= ASYNC_LOW_LATENCY;
+        if(ioctl(_port, TIOCSSERIAL, &serial) != 0)
+        {
+            Log("Could not set low latency flag on serial port", Debug | RawSerialContinuous);
+        }
+    }
+    else
+    {
+        Log("Serial port does not support low latency flag", Debug | RawSerialContinuous);
+    }
+
+    // Throw out anything that was sitting around from before we opened.
+    tcflush(_port, TCIOFLUSH);
+
+    _epoll = epoll_create1(EPOLL_CLOEXEC);
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = _port;
+    if(_epoll < 0 || epoll_ctl(_epoll, EPOLL_CTL_ADD, _port, &ev) != 0)
+    {
+        throw runtime_error("Could not set up serial port polling.");
+    }
+}
+
+bool SerialPort::WaitForData(int timeoutMs)
+{
+    if(_epoll < 0)
+    {
+        // Blocking ports do their waiting in read.
+        return true;
+    }
+
+    epoll_event ev;
+    int res = epoll_wait(_epoll, &ev, 1, timeoutMs);
+    if(res < 0 && errno != EINTR)
+    {
+        throw runtime_error("Failed waiting for serial data.");
+    }
+
+    return res > 0;
+}
+
 int SerialPort::Read(unsigned char* buffer, int bytesToRead)
 {
     Log("Trying to read " + to_string(bytesToRead) + " bytes.", RawSerialContinuous);
+
+    // Same as VTIME for the blocking port, wait up to .1s for something to show up.
+    if(_lowLatency && !WaitForData(100))
+    {
+        return 0;
+    }
+
     int bytesRead = read(_port, buffer, bytesToRead);
 
     // Make sure it worked.
     if(bytesRead == -1)
     {
+        if(_lowLatency && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            return 0;
+        }
+
         throw runtime_error("Failed to read bytes.");
     }
 
@@ -98,11 +188,26 @@ int SerialPort::Read(unsigned char* buffer, int bytesToRead)
 int SerialPort::Write(unsigned char* data, int bytesToWrite)
 {
     Log("Trying to write " + to_string(bytesToWrite) + " bytes (" + ToHex(data, bytesToWrite) + ")", RawSerialContinuous | RawSerial);
-    int bytesWritten = write(_port, data, bytesToWrite);
-
-    if(bytesWritten == -1)
+    int bytesWritten = 0;
+    while(bytesWritten < bytesToWrite)
     {
-        throw runtime_error("Failed to write bytes.");
+        int res = write(_port, data + bytesWritten, bytesToWrite - bytesWritten);
+        if(res == -1)
+        {
+            // A non-blocking port may not have room yet. Wait for it instead of dropping the command.
+            if(_lowLatency && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                pollfd pfd;
+                pfd.fd = _port;
+                pfd.events = POLLOUT;
+                poll(&pfd, 1, 100);
+                continue;
+            }
+
+            throw runtime_error("Failed to write bytes.");
+        }
+
+        bytesWritten += res;
     }
 
     Log("Wrote " + to_string(bytesWritten) + " bytes.", RawSerialContinuous | RawSerial);
@@ -117,6 +222,12 @@ void SerialPort::Clear()
 
 void SerialPort::Close()
 {
+    if(_epoll >= 0)
+    {
+        close(_epoll);
+        _epoll = -1;
+    }
+
     close(_port);
 }
 
@@ -40,6 +40,7 @@ MotorConfig Settings::ReadMotorConfig(Document& doc, string motorConfigName)
     mc.angleBounds.min = doc[motorConfigName.c_str()]["AngleBounds"]["Min"].GetInt();
     mc.stepBounds.max = doc[motorConfigName.c_str()]["StepBounds"]["Max"].GetInt();
     mc.stepBounds.min = doc[motorConfigName.c_str()]["StepBounds"]["Min"].GetInt();
+    mc.maxSpeed = doc[motorConfigName.c_str()]["MaxSpeed"].GetDouble();
     return mc;
 }
 
@@ -77,6 +78,7 @@ SerialConfig Settings::ReadSerialConfig(Document& doc, string serialConfigName)
     SerialConfig sc;
     sc.path = doc[serialConfigName.c_str()]["Path"].GetString();
     sc.baudRate = ParseBaudRate(doc[serialConfigName.c_str()]["BaudRate"].GetInt());
+    sc.lowLatency = doc[serialConfigName.c_str()]["LowLatency"].GetBool();
     return sc;
 }
 
@@ -93,6 +95,83 @@ ImageProcessingConfig Settings::ReadImageProcessingConfig(Document& doc, string
     config.showBoxes = doc[imageProcessingConfigName.c_str()]["ShowBoxes"].GetBool();
     config.moveCamera = doc[imageProcessingConfigName.c_str()]["MoveCamera"].GetBool();
     config.recordFilter = doc[imageProcessingConfigName.c_str()]["RecordFilter"].GetBool();
+    config.recordDetections = doc[imageProcessingConfigName.c_str()]["RecordDetections"].GetBool();
+    config.maxFrameAge = doc[imageProcessingConfigName.c_str()]["MaxFrameAge"].GetInt();
+
+    return config;
+}
+
+TrackerConfig Settings::ReadTrackerConfig(Document& doc, string trackerConfigName)
+{
+    TrackerConfig config;
+    config.enabled = doc[trackerConfigName.c_str()]["Enabled"].GetBool();
+    config.alpha = doc[trackerConfigName.c_str()]["Alpha"].GetDouble();
+    config.beta = doc[trackerConfigName.c_str()]["Beta"].GetDouble();
+    config.leadTime = doc[trackerConfigName.c_str()]["LeadTime"].GetInt();
+    config.deadband = doc[trackerConfigName.c_str()]["Deadband"].GetDouble();
+    config.maxMisses = doc[trackerConfigName.c_str()]["MaxMisses"].GetInt();
+    config.velocityControl = doc[trackerConfigName.c_str()]["VelocityControl"].GetBool();
+    config.velocityGain = doc[trackerConfigName.c_str()]["VelocityGain"].GetDouble();
+
+    return config;
+}
+
+ColorCacheConfig Settings::ReadColorCacheConfig(Document& doc, string colorCacheConfigName)
+{
+    ColorCacheConfig config;
+    config.maxFrames = doc[colorCacheConfigName.c_str()]["MaxFrames"].GetInt();
+    config.maxTime = doc[colorCacheConfigName.c_str()]["MaxTime"].GetInt();
+    config.minIoU = doc[colorCacheConfigName.c_str()]["MinIoU"].GetDouble();
+    config.maxConfidenceChange = doc[colorCacheConfigName.c_str()]["MaxConfidenceChange"].GetFloat();
+
+    return config;
+}
+
+MotionGatingConfig Settings::ReadMotionGatingConfig(Document& doc, string motionGatingConfigName)
+{
+    MotionGatingConfig config;
+    config.enabled = doc[motionGatingConfigName.c_str()]["Enabled"].GetBool();
+    config.maxSlewRate = doc[motionGatingConfigName.c_str()]["MaxSlewRate"].GetDouble();
+    config.compensate = doc[motionGatingConfigName.c_str()]["Compensate"].GetBool();
+
+    return config;
+}
+
+AdaptiveReadoutConfig Settings::ReadAdaptiveReadoutConfig(Document& doc, string adaptiveReadoutConfigName)
+{
+    AdaptiveReadoutConfig config;
+    config.enabled = doc[adaptiveReadoutConfigName.c_str()]["Enabled"].GetBool();
+    config.wideBinning = doc[adaptiveReadoutConfigName.c_str()]["WideBinning"].GetInt();
+    config.trackingCrop = doc[adaptiveReadoutConfigName.c_str()]["TrackingCrop"].GetDouble();
+    config.stableFrames = doc[adaptiveReadoutConfigName.c_str()]["StableFrames"].GetInt();
+    config.lostFrames = doc[adaptiveReadoutConfigName.c_str()]["LostFrames"].GetInt();
+    config.holdFrames = doc[adaptiveReadoutConfigName.c_str()]["HoldFrames"].GetInt();
+
+    // Binning is whole pixels, and cropping can't read out more than the frame.
+    if(config.wideBinning < 1 || config.trackingCrop <= 0 || config.trackingCrop > 1)
+    {
+        throw runtime_error("Adaptive readout needs a binning of at least 1 and a crop between 0 and 1.");
+    }
+
+    return config;
+}
+
+FrameRateGovernorConfig Settings::ReadFrameRateGovernorConfig(Document& doc, string frameRateGovernorConfigName)
+{
+    FrameRateGovernorConfig config;
+    config.enabled = doc[frameRateGovernorConfigName.c_str()]["Enabled"].GetBool();
+    config.minRate = doc[frameRateGovernorConfigName.c_str()]["MinRate"].GetDouble();
+    config.maxRate = doc[frameRateGovernorConfigName.c_str()]["MaxRate"].GetDouble();
+    config.step = doc[frameRateGovernorConfigName.c_str()]["Step"].GetDouble();
+    config.interval = doc[frameRateGovernorConfigName.c_str()]["Interval"].GetInt();
+    config.maxLoad = doc[frameRateGovernorConfigName.c_str()]["MaxLoad"].GetDouble();
+    config.raiseIntervals = doc[frameRateGovernorConfigName.c_str()]["RaiseIntervals"].GetInt();
+    config.maxBacklog = doc[frameRateGovernorConfigName.c_str()]["MaxBacklog"].GetInt();
+
+    if(config.minRate <= 0 || config.minRate > config.maxRate || config.step <= 0 || config.interval <= 0)
+    {
+        throw runtime_error("Frame rate governor needs 0 < MinRate <= MaxRate, and a positive Step and Interval.");
+    }
 
     return config;
 }
@@ -106,6 +185,28 @@ Scalar Settings::ReadHSV(Document& doc, string hsvName)
     return hsv;
 }
 
+map<string, ThreadConfig> Settings::ReadThreadConfigs(Document& doc, string threadConfigsName)
+{
+    // Each member is the name of a worker group.
+    map<string, ThreadConfig> configs;
+    Value& configsValue = doc[threadConfigsName.c_str()];
+    for(auto member = configsValue.MemberBegin(); member != configsValue.MemberEnd(); member++)
+    {
+        ThreadConfig config;
+        Value& cpus = member->value["Cpus"];
+        for(SizeType i = 0; i < cpus.Size(); i++)
+        {
+            config.cpus.push_back(cpus[i].GetInt());
+        }
+
+        // Zero means leave it on the normal scheduler.
+        config.fifoPriority = member->value["FifoPriority"].GetInt();
+        configs[member->name.GetString()] = config;
+    }
+
+    return configs;
+}
+
 speed_t Settings::ParseBaudRate(int baudRate)
 {
     switch(baudRate)
@@ -116,6 +217,45 @@ speed_t Settings::ParseBaudRate(int baudRate)
         case 115200:
             return B115200;
 
+        case 230400:
+            return B230400;
+
+        case 460800:
+            return B460800;
+
+        case 500000:
+            return B500000;
+
+        case 576000:
+            return B576000;
+
+        case 921600:
+            return B921600;
+
+        case 1000000:
+            return B1000000;
+
+        case 1152000:
+            return B1152000;
+
+        case 1500000:
+            return B1500000;
+
+        case 2000000:
+            return B2000000;
+
+        case 2500000:
+            return B2500000;
+
+        case 3000000:
+            return B3000000;
+
+        case 3500000:
+            return B3500000;
+
+        case 4000000:
+            return B4000000;
+
         default:
             throw runtime_error("Unimplemented baud rate: " + to_string(baudRate));
     }
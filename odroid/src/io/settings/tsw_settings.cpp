@@ -15,6 +15,26 @@ using namespace rapidjson;
 TswSettings::TswSettings()
 {
     CameraFramesToSkipMoving = 0;
+    LockMemory = false;
+    ThreadSampleInterval = 0;
+    MetricsInterval = 0;
+    TraceDuration = 0;
+    ArmedStandby = false;
+    CameraStandbyFrameRate = 0;
+    AdaptiveReadout.enabled = false;
+    AdaptiveReadout.wideBinning = 1;
+    AdaptiveReadout.trackingCrop = 1;
+    AdaptiveReadout.stableFrames = 0;
+    AdaptiveReadout.lostFrames = 0;
+    AdaptiveReadout.holdFrames = 0;
+    FrameRateGovernor.enabled = false;
+    FrameRateGovernor.minRate = 0;
+    FrameRateGovernor.maxRate = 0;
+    FrameRateGovernor.step = 0;
+    FrameRateGovernor.interval = 0;
+    FrameRateGovernor.maxLoad = 0;
+    FrameRateGovernor.raiseIntervals = 0;
+    FrameRateGovernor.maxBacklog = 0;
 }
 
 TswSettings::TswSettings(string settingsFile)
@@ -41,6 +61,7 @@ void TswSettings::Load(string settingsFile)
     SafeRegionProportion = ReadVector2(doc, "SafeRegionProportion");
     CameraFramesToSkipMoving = doc["CameraFramesToSkipMoving"].GetInt();
     CameraFrameRate = doc["CameraFrameRate"].GetDouble();
+    CameraStandbyFrameRate = doc["CameraStandbyFrameRate"].GetDouble();
     CameraFrameHeight = doc["CameraFrameHeight"].GetInt();
     CameraFrameWidth = doc["CameraFrameWidth"].GetInt();
     PanConfig = ReadMotorConfig(doc, "PanConfig");
@@ -55,6 +76,21 @@ void TswSettings::Load(string settingsFile)
     MaxOfficerHSV = ReadHSV(doc, "MaxOfficerHSV");
     OfficerThreshold = doc["OfficerThreshold"].GetDouble();
     MotorSpeeds = ReadByteVector2(doc, "MotorSpeeds");
+    ThreadConfigs = ReadThreadConfigs(doc, "ThreadConfigs");
+    LockMemory = doc["LockMemory"].GetBool();
+    ThreadSampleInterval = doc["ThreadSampleInterval"].GetInt();
+    MetricsPath = doc["MetricsPath"].GetString();
+    MetricsInterval = doc["MetricsInterval"].GetInt();
+    TracePath = doc["TracePath"].GetString();
+    TraceDuration = doc["TraceDuration"].GetInt();
+    TrackingConfig = ReadTrackerConfig(doc, "TrackingConfig");
+    OfficerColorCache = ReadColorCacheConfig(doc, "OfficerColorCache");
+    GuidanceRate = doc["GuidanceRate"].GetInt();
+    UseSearchTrajectory = doc["UseSearchTrajectory"].GetBool();
+    MotionGating = ReadMotionGatingConfig(doc, "MotionGating");
+    ArmedStandby = doc["ArmedStandby"].GetBool();
+    AdaptiveReadout = ReadAdaptiveReadoutConfig(doc, "AdaptiveReadout");
+    FrameRateGovernor = ReadFrameRateGovernorConfig(doc, "FrameRateGovernor");
 
     // Get the log settings.
     LogFlags = ReadLogFlags(doc, "LogFlags");
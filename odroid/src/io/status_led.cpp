@@ -22,7 +22,8 @@ void StatusLED::StartFlashing(int flashesPerPause)
     if(IsEnabled() && !IsFlashing())
     {
         _isFlashing = true;
-        _flashFuture = async(launch::async, [this]()
+        _stopSignal.Clear();
+        _flashFuture = Executor::Instance().Submit(STATUS_GROUP, [this]()
         {
             RunFlash();
         });
@@ -34,6 +35,7 @@ void StatusLED::StopFlashing(bool reset)
     if(IsEnabled() && IsFlashing())
     {
         _isFlashing = false;
+        _stopSignal.Notify();
         
         // Wait for the flashing to actually be done.
         _flashFuture.wait();
@@ -79,14 +81,15 @@ void StatusLED::RunFlash()
             SetBrightness(LED_ON);
 
             // Wait a bit so the light stays on for a bit.
-            usleep(FLASH_ON_TIME);
+            // If we get stopped in the meantime, this wakes right up.
+            _stopSignal.Wait(FLASH_ON_TIME / 1000);
 
 
             if(IsFlashing())
             {
                 // Turn off and wait for the next set.
                 SetBrightness(LED_OFF);
-                usleep(FLASH_OFF_TIME);
+                _stopSignal.Wait(FLASH_OFF_TIME / 1000);
             }
         }
 
@@ -100,7 +103,7 @@ void StatusLED::RunFlash()
         {
             // One last flash on.
             SetBrightness(LED_ON);
-            usleep(FLASH_ON_TIME);
+            _stopSignal.Wait(FLASH_ON_TIME / 1000);
         }
         
 
@@ -109,7 +112,7 @@ void StatusLED::RunFlash()
         {
             // Pause before the next set of flashes.
             SetBrightness(LED_OFF);
-            usleep(PauseTime);
+            _stopSignal.Wait(PauseTime / 1000);
         }
 
         Log("Flash sequence finished", LED);
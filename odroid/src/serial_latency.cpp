@@ -0,0 +1,71 @@
+#include "io.hpp"
+#include "settings.hpp"
+#include <chrono>
+#include <algorithm>
+
+using namespace tsw::io;
+using namespace tsw::io::settings;
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    if(argc != 3)
+    {
+        cout << "Usage: serial_latency <motors|device> <round_trips>" << endl;
+        return 1;
+    }
+
+    string portName(argv[1]);
+    int roundTrips = atoi(argv[2]);
+    if(roundTrips <= 0)
+    {
+        cout << "Need at least one round trip" << endl;
+        return 1;
+    }
+
+    // Use the same port settings as the real thing so we measure what tsw actually sees.
+    string thisFile(argv[0]);
+    string startingDir = thisFile.substr(0, thisFile.find_last_of('/'));
+    TswSettings settings(startingDir + "/tsw.json");
+    ConfigureLog(settings.LogFlags);
+    SerialConfig config = portName == "device" ? settings.DeviceSerialConfig : settings.MotorsSerialConfig;
+
+    // The device port owns the raw port and deletes it when it is done.
+    SerialPort* port = new SerialPort(config.baudRate, config.lowLatency);
+    port->Open(config.path);
+    DeviceSerialPort devicePort(*port);
+    devicePort.StartGathering();
+
+    cout << "Measuring " << roundTrips << " round trips on " << config.path << " (low latency " << (config.lowLatency ? "on" : "off") << ")" << endl;
+
+    // Flipping the headlights is the cheapest thing we can send that the motors always acknowledge.
+    vector<double> rtts;
+    for(int i = 0; i < roundTrips; i++)
+    {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        devicePort.WriteToDevice(Motors, Headlights, (unsigned char)(i % 2 ? HEADLIGHTS_OFFICER_VISIBLE : 0));
+        devicePort.ReadFromDevice(Motors, 0x8f);
+        chrono::steady_clock::time_point end = chrono::steady_clock::now();
+        rtts.push_back(chrono::duration<double, micro>(end - start).count());
+    }
+
+    // Leave the lights how we found them.
+    devicePort.WriteToDevice(Motors, Headlights, (unsigned char)0);
+    devicePort.ReadFromDevice(Motors, 0x8f);
+    devicePort.StopGathering();
+
+    sort(rtts.begin(), rtts.end());
+    double total = 0;
+    for(double rtt : rtts)
+    {
+        total += rtt;
+    }
+
+    cout << "RTT us: min " << rtts.front()
+        << " p50 " << rtts[rtts.size() / 2]
+        << " p99 " << rtts[min(rtts.size() - 1, rtts.size() * 99 / 100)]
+        << " max " << rtts.back()
+        << " mean " << total / rtts.size() << endl;
+
+    return 0;
+}
@@ -0,0 +1,84 @@
+#include "simulation.hpp"
+
+using namespace tsw::simulation;
+
+FrameRenderer::FrameRenderer(int frameWidth, int frameHeight, double horizontalFov, double verticalFov, Scalar officerHSV, unsigned int seed) : _rng(seed)
+{
+    _frameWidth = frameWidth;
+    _frameHeight = frameHeight;
+    _horizontalFov = horizontalFov;
+    _verticalFov = verticalFov;
+    OfficerClassId = 0;
+    PixelJitter = 0;
+    MissRate = 0;
+
+    // A plain gray world, the only thing with any color in it is the officer.
+    _background = Scalar(90, 90, 90);
+    _frame = Mat(frameHeight, frameWidth, CV_8UC3, _background);
+    Mat hsv(1, 1, CV_8UC3, officerHSV);
+    Mat rgb;
+    cvtColor(hsv, rgb, COLOR_HSV2RGB);
+    Vec3b color = rgb.at<Vec3b>(0, 0);
+    _officerColor = Scalar(color[0], color[1], color[2]);
+}
+
+Vector2 FrameRenderer::ToPixel(Vector2 gimbalAngles, Vector2 worldAngles)
+{
+    // The center of the frame is wherever the gimbal is pointing.
+    Vector2 pixel;
+    pixel.x = _frameWidth / 2.0 + (worldAngles.x - gimbalAngles.x) / _horizontalFov * _frameWidth;
+    pixel.y = _frameHeight / 2.0 + (worldAngles.y - gimbalAngles.y) / _verticalFov * _frameHeight;
+    return pixel;
+}
+
+bool FrameRenderer::Render(Vector2 gimbalAngles, Vector2 officerAngles, bool officerVisible, vector<InferenceBoundingBox>& boxes)
+{
+    boxes.clear();
+
+    // Only the officer changes between frames, so just paint over where they were.
+    rectangle(_frame, _lastOfficerRect, _background, FILLED);
+    _lastOfficerRect = Rect();
+
+    Vector2 center = ToPixel(gimbalAngles, officerAngles);
+    double width = SIM_OFFICER_WIDTH / _horizontalFov * _frameWidth;
+    double height = SIM_OFFICER_HEIGHT / _verticalFov * _frameHeight;
+    Rect officerRect((int)(center.x - width / 2), (int)(center.y - height / 2), (int)width, (int)height);
+    Rect onFrame = officerRect & Rect(0, 0, _frameWidth, _frameHeight);
+    if(!officerVisible || onFrame.area() == 0)
+    {
+        return false;
+    }
+
+    rectangle(_frame, onFrame, _officerColor, FILLED);
+    _lastOfficerRect = onFrame;
+
+    // Every now and then the camera just doesn't see them.
+    uniform_real_distribution<double> missDist(0, 1);
+    if(missDist(_rng) < MissRate)
+    {
+        return true;
+    }
+
+    // The camera's boxes are never quite right, and they hang off the edge of the frame like the real ones do.
+    normal_distribution<double> jitterDist(0, PixelJitter > 0 ? PixelJitter : 1);
+    auto jittered = [&](double coordinate)
+    {
+        coordinate += PixelJitter > 0 ? jitterDist(_rng) : 0;
+        return (short)max(-32000.0, min(32000.0, coordinate));
+    };
+
+    InferenceBoundingBox box;
+    box.classId = OfficerClassId;
+    box.confidence = 0.9;
+    box.rect.topLeftXCoord = jittered(officerRect.x);
+    box.rect.topLeftYCoord = jittered(officerRect.y);
+    box.rect.bottomRightXCoord = jittered(officerRect.x + officerRect.width);
+    box.rect.bottomRightYCoord = jittered(officerRect.y + officerRect.height);
+    boxes.push_back(box);
+    return true;
+}
+
+Mat FrameRenderer::GetFrame()
+{
+    return _frame;
+}
@@ -0,0 +1,353 @@
+#include "simulation.hpp"
+#include <cmath>
+
+using namespace tsw::simulation;
+
+GimbalPlant::GimbalPlant(MotorConfig panConfig, MotorConfig tiltConfig, Vector2 startAngles)
+{
+    _panConfig = panConfig;
+    _tiltConfig = tiltConfig;
+    _angles = startAngles;
+    _target = startAngles;
+    _isActive = false;
+    _isSyncMove = false;
+    _isVelocityMode = false;
+    _velocity.x = 0;
+    _velocity.y = 0;
+    _velocityEndUs = 0;
+    _isTrajectoryRunning = false;
+    _isDwelling = false;
+    _trajectoryFinished = false;
+    _trajectoryIndex = 0;
+    _dwellLeft = 0;
+    _loopsLeft = 0;
+    _moveCount = 0;
+    _lastUpdateUs = 0;
+
+    // Same default speed the firmware boots up with.
+    _slewRates.x = DEFAULT_MOTOR_SPEED / 255.0 * panConfig.maxSpeed;
+    _slewRates.y = DEFAULT_MOTOR_SPEED / 255.0 * tiltConfig.maxSpeed;
+}
+
+void GimbalPlant::ApplyCommand(DeviceMessage& message, int64_t nowUs)
+{
+    // The bottom nibble of the header is the action, everything after it is the arguments.
+    PendingCommand command;
+    command.applyUs = nowUs + SIM_COMMAND_LATENCY_US;
+    command.action = (CommandAction)(message.bytes[0] & 0x0f);
+    command.angles = _target;
+    command.speeds.x = 0;
+    command.speeds.y = 0;
+    command.timeoutUs = 0;
+    command.opcode = TrajectoryClear;
+    command.value = 0;
+
+    switch(command.action)
+    {
+        case RelativeMoveSynchronous:
+        case RelativeMoveAsynchronous:
+        case AbsoluteMoveSynchronous:
+        case AbsoluteMoveAsynchronous:
+            // The angles come across the same way the motor controller packed them.
+            command.angles.x = MotorValueToAngle(message.bytes, 1, _panConfig);
+            command.angles.y = MotorValueToAngle(message.bytes, 4, _tiltConfig);
+            _moveCount++;
+            break;
+
+        case SetVelocity:
+            // Rates are packed just like the relative moves, with the timeout tacked on the end.
+            command.angles.x = MotorValueToAngle(message.bytes, 1, _panConfig);
+            command.angles.y = MotorValueToAngle(message.bytes, 4, _tiltConfig);
+            command.timeoutUs = message.bytes[7] * VELOCITY_TIMEOUT_UNIT_MS * 1000LL;
+            _moveCount++;
+            break;
+
+        case Trajectory:
+            // The opcode comes first, then its arguments.
+            command.opcode = (TrajectoryOpcode)message.bytes[1];
+            if(command.opcode == TrajectoryAddWaypoint)
+            {
+                command.angles.x = MotorValueToAngle(message.bytes, 2, _panConfig);
+                command.angles.y = MotorValueToAngle(message.bytes, 5, _tiltConfig);
+            }
+            else if(command.opcode == TrajectorySetDwell)
+            {
+                command.value = message.bytes[2] << 8 | message.bytes[3];
+            }
+            else if(command.opcode == TrajectoryExecute)
+            {
+                command.value = message.bytes[2];
+                _moveCount++;
+            }
+            break;
+
+        case SetSpeeds:
+            command.speeds.x = message.bytes[1];
+            command.speeds.y = message.bytes[2];
+            break;
+
+        default:
+            break;
+    }
+
+    _pending.push_back(command);
+}
+
+bool GimbalPlant::Update(int64_t nowUs)
+{
+    // Play out every command that kicked in since the last update, in order, so the motion between them is right.
+    while(!_pending.empty() && _pending.front().applyUs <= nowUs)
+    {
+        PendingCommand command = _pending.front();
+        _pending.pop_front();
+        AdvanceTo(command.applyUs);
+
+        // A position move takes over from a velocity or a trajectory, and a velocity takes over from a trajectory.
+        if(command.action >= RelativeMoveSynchronous && command.action <= AbsoluteMoveAsynchronous)
+        {
+            _isVelocityMode = false;
+            _isTrajectoryRunning = false;
+        }
+        else if(command.action == SetVelocity)
+        {
+            _isTrajectoryRunning = false;
+        }
+
+        switch(command.action)
+        {
+            case Trajectory:
+                ApplyTrajectoryCommand(command);
+                break;
+
+            case SetVelocity:
+                _velocity = command.angles;
+                _velocityEndUs = command.applyUs + command.timeoutUs;
+                _isVelocityMode = true;
+                _isSyncMove = false;
+                break;
+
+            case RelativeMoveSynchronous:
+            case RelativeMoveAsynchronous:
+                _target.x = _angles.x + command.angles.x;
+                _target.y = _angles.y + command.angles.y;
+                _isSyncMove = command.action == RelativeMoveSynchronous;
+                break;
+
+            case AbsoluteMoveSynchronous:
+            case AbsoluteMoveAsynchronous:
+                _target = command.angles;
+                _isSyncMove = command.action == AbsoluteMoveSynchronous;
+                break;
+
+            case SetSpeeds:
+                _slewRates.x = command.speeds.x / 255.0 * _panConfig.maxSpeed;
+                _slewRates.y = command.speeds.y / 255.0 * _tiltConfig.maxSpeed;
+                break;
+
+            case Activate:
+                _isActive = true;
+                break;
+
+            case Deactivate:
+                _isActive = false;
+                break;
+
+            default:
+                break;
+        }
+    }
+
+    AdvanceTo(nowUs);
+
+    // Sync moves get a success once they get where they were going, trajectories once they run out of loops.
+    if(_isSyncMove && _angles.x == _target.x && _angles.y == _target.y)
+    {
+        _isSyncMove = false;
+        return true;
+    }
+
+    if(_trajectoryFinished)
+    {
+        _trajectoryFinished = false;
+        return true;
+    }
+
+    return false;
+}
+
+void GimbalPlant::ApplyTrajectoryCommand(PendingCommand& command)
+{
+    switch(command.opcode)
+    {
+        case TrajectoryClear:
+            _trajectory.clear();
+            _isTrajectoryRunning = false;
+            break;
+
+        case TrajectoryAddWaypoint:
+            if(_trajectory.size() < TRAJECTORY_MAX_WAYPOINTS)
+            {
+                TrajectoryWaypoint waypoint;
+                waypoint.angles = command.angles;
+                waypoint.dwell = 0;
+                _trajectory.push_back(waypoint);
+            }
+            break;
+
+        case TrajectorySetDwell:
+            if(!_trajectory.empty())
+            {
+                _trajectory.back().dwell = command.value;
+            }
+            break;
+
+        case TrajectoryExecute:
+            _isTrajectoryRunning = !_trajectory.empty();
+            _isVelocityMode = false;
+            _isSyncMove = false;
+            _isDwelling = false;
+            _trajectoryIndex = 0;
+            _loopsLeft = command.value;
+            break;
+
+        case TrajectoryAbort:
+            _isTrajectoryRunning = false;
+            _target = _angles;
+            break;
+    }
+}
+
+Vector2 GimbalPlant::GetAngles()
+{
+    return _angles;
+}
+
+bool GimbalPlant::IsActive()
+{
+    return _isActive;
+}
+
+uint GimbalPlant::GetMoveCount()
+{
+    return _moveCount;
+}
+
+void GimbalPlant::AdvanceTo(int64_t nowUs)
+{
+    // Velocities stop on their own once the timeout runs out, so split the step there.
+    if(_isVelocityMode && _velocityEndUs <= nowUs)
+    {
+        Step((_velocityEndUs - _lastUpdateUs) / 1000000.0);
+        _lastUpdateUs = max(_lastUpdateUs, _velocityEndUs);
+        _isVelocityMode = false;
+        _target = _angles;
+    }
+
+    Step((nowUs - _lastUpdateUs) / 1000000.0);
+    _lastUpdateUs = nowUs;
+}
+
+void GimbalPlant::Step(double seconds)
+{
+    // Deactivated motors just sit there.
+    if(!_isActive || seconds <= 0)
+    {
+        return;
+    }
+
+    if(_isTrajectoryRunning)
+    {
+        StepTrajectory(seconds);
+        return;
+    }
+
+    if(_isVelocityMode)
+    {
+        // Can't go any faster than the speed setting allows.
+        _angles.x += max(-_slewRates.x, min(_slewRates.x, _velocity.x)) * seconds;
+        _angles.y += max(-_slewRates.y, min(_slewRates.y, _velocity.y)) * seconds;
+        _target = _angles;
+        return;
+    }
+
+    _angles.x = MoveAxis(_angles.x, _target.x, _slewRates.x * seconds);
+    _angles.y = MoveAxis(_angles.y, _target.y, _slewRates.y * seconds);
+}
+
+void GimbalPlant::StepTrajectory(double seconds)
+{
+    // A single step can cover a few legs of the trajectory, so keep going until the time runs out.
+    // A loop where every waypoint is right here with no dwell would never use any, so bail on that too.
+    size_t idleLegs = 0;
+    while(seconds > 0 && _isTrajectoryRunning && idleLegs <= _trajectory.size())
+    {
+        double startSeconds = seconds;
+        TrajectoryWaypoint& waypoint = _trajectory[_trajectoryIndex];
+        if(!_isDwelling)
+        {
+            // Both axes move at their own speed, the leg is done once the slower one gets there.
+            double dx = fabs(waypoint.angles.x - _angles.x);
+            double dy = fabs(waypoint.angles.y - _angles.y);
+            double needed = max(_slewRates.x > 0 ? dx / _slewRates.x : (dx > 0 ? seconds : 0), _slewRates.y > 0 ? dy / _slewRates.y : (dy > 0 ? seconds : 0));
+            double used = min(needed, seconds);
+            _angles.x = MoveAxis(_angles.x, waypoint.angles.x, _slewRates.x * used);
+            _angles.y = MoveAxis(_angles.y, waypoint.angles.y, _slewRates.y * used);
+            seconds -= used;
+            if(_angles.x != waypoint.angles.x || _angles.y != waypoint.angles.y)
+            {
+                break;
+            }
+
+            _isDwelling = true;
+            _dwellLeft = waypoint.dwell / 1000.0;
+        }
+
+        double dwell = min(_dwellLeft, seconds);
+        _dwellLeft -= dwell;
+        seconds -= dwell;
+        if(_dwellLeft > 0)
+        {
+            break;
+        }
+
+        // On to the next one, wrapping around if there are loops left.
+        idleLegs = seconds == startSeconds ? idleLegs + 1 : 0;
+        _isDwelling = false;
+        if(++_trajectoryIndex >= _trajectory.size())
+        {
+            _trajectoryIndex = 0;
+            if(_loopsLeft > 0 && --_loopsLeft == 0)
+            {
+                _isTrajectoryRunning = false;
+                _trajectoryFinished = true;
+            }
+        }
+    }
+
+    _target = _angles;
+}
+
+double GimbalPlant::MoveAxis(double angle, double target, double maxStep)
+{
+    double remaining = target - angle;
+    if(fabs(remaining) <= maxStep)
+    {
+        return target;
+    }
+
+    return angle + (remaining > 0 ? maxStep : -maxStep);
+}
+
+double GimbalPlant::MotorValueToAngle(vector<unsigned char>& bytes, int start, MotorConfig config)
+{
+    // Three big endian bytes, sign extended.
+    int value = bytes[start] << 16 | bytes[start + 1] << 8 | bytes[start + 2];
+    if(value & 0x800000)
+    {
+        value |= 0xff000000;
+    }
+
+    // This is the reverse of MotorController::AngleToMotorValue.
+    double stepProp = (value - config.stepBounds.min) / (double)(config.stepBounds.max - config.stepBounds.min);
+    return config.angleBounds.min + stepProp * (config.angleBounds.max - config.angleBounds.min);
+}
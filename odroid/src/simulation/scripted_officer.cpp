@@ -0,0 +1,106 @@
+#include "simulation.hpp"
+#include <cmath>
+
+using namespace tsw::simulation;
+
+ScriptedOfficer::ScriptedOfficer(vector<OfficerWaypoint> waypoints)
+{
+    if(waypoints.empty())
+    {
+        throw runtime_error("Officer needs at least one waypoint.");
+    }
+
+    _waypoints = waypoints;
+}
+
+OfficerWaypoint MakeWaypoint(int64_t timeUs, Vector2 origin, double pan, double tilt, bool visible = true)
+{
+    OfficerWaypoint waypoint;
+    waypoint.timeUs = timeUs;
+    waypoint.angles.x = origin.x + pan;
+    waypoint.angles.y = origin.y + tilt;
+    waypoint.visible = visible;
+    return waypoint;
+}
+
+ScriptedOfficer ScriptedOfficer::FromScenario(string scenario, int64_t durationUs, Vector2 origin)
+{
+    // Angles are relative to where the gimbal starts. Positive tilt is down, same as the motors.
+    vector<OfficerWaypoint> waypoints;
+    if(scenario == "stand")
+    {
+        // Just off center, this is all about how we settle.
+        waypoints.push_back(MakeWaypoint(0, origin, 6, 2));
+    }
+    else if(scenario == "walk")
+    {
+        // A steady walk across the front of the car, about 1.5 degrees a second.
+        waypoints.push_back(MakeWaypoint(0, origin, 0, 1));
+        waypoints.push_back(MakeWaypoint(durationUs, origin, durationUs / 1000000.0 * 1.5, 1));
+    }
+    else if(scenario == "pace")
+    {
+        // Back and forth beside the car, turning around every 4 seconds.
+        for(int64_t t = 0; t <= durationUs; t += 4000000)
+        {
+            waypoints.push_back(MakeWaypoint(t, origin, (t / 4000000) % 2 ? 12 : -12, 1));
+        }
+    }
+    else if(scenario == "sprint")
+    {
+        // Standing around, then a quick dash to the other side of the car.
+        waypoints.push_back(MakeWaypoint(0, origin, -10, 1));
+        waypoints.push_back(MakeWaypoint(3000000, origin, -10, 1));
+        waypoints.push_back(MakeWaypoint(4500000, origin, 20, 2));
+    }
+    else if(scenario == "hide")
+    {
+        // Walking, but ducking behind the car for a couple seconds at a time.
+        for(int64_t t = 0; t <= durationUs; t += 2000000)
+        {
+            bool visible = (t / 2000000) % 3 != 2;
+            waypoints.push_back(MakeWaypoint(t, origin, t / 1000000.0 * 1.5, 1, visible));
+        }
+    }
+    else
+    {
+        throw runtime_error("Unknown scenario " + scenario + ".");
+    }
+
+    return ScriptedOfficer(waypoints);
+}
+
+size_t ScriptedOfficer::FindSegment(int64_t nowUs)
+{
+    // Few enough waypoints that a linear search is fine.
+    size_t segment = 0;
+    while(segment + 1 < _waypoints.size() && _waypoints[segment + 1].timeUs <= nowUs)
+    {
+        segment++;
+    }
+
+    return segment;
+}
+
+Vector2 ScriptedOfficer::GetAngles(int64_t nowUs)
+{
+    size_t segment = FindSegment(nowUs);
+    OfficerWaypoint& from = _waypoints[segment];
+    if(segment + 1 >= _waypoints.size() || nowUs <= from.timeUs)
+    {
+        // Past the end of the script, the officer just stays put.
+        return from.angles;
+    }
+
+    OfficerWaypoint& to = _waypoints[segment + 1];
+    double prop = (nowUs - from.timeUs) / (double)(to.timeUs - from.timeUs);
+    Vector2 angles;
+    angles.x = from.angles.x + prop * (to.angles.x - from.angles.x);
+    angles.y = from.angles.y + prop * (to.angles.y - from.angles.y);
+    return angles;
+}
+
+bool ScriptedOfficer::IsVisible(int64_t nowUs)
+{
+    return _waypoints[FindSegment(nowUs)].visible;
+}
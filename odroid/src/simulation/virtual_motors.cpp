@@ -0,0 +1,133 @@
+#include "simulation.hpp"
+#include <sys/socket.h>
+#include <poll.h>
+#include <unistd.h>
+
+using namespace tsw::simulation;
+
+VirtualMotors::VirtualMotors(GimbalPlant& plant, Clock& clock)
+{
+    _plant = &plant;
+    _clock = &clock;
+    _messageSignal = nullptr;
+    _isRunning = false;
+
+    // One end is us, the other gets attached to the serial port tsw talks through.
+    if(socketpair(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0, _fds) != 0)
+    {
+        throw runtime_error("Could not create virtual motor socket.");
+    }
+}
+
+int VirtualMotors::GetTswFd()
+{
+    return _fds[1];
+}
+
+void VirtualMotors::WatchGatherer(EventSignal& messageSignal)
+{
+    _messageSignal = &messageSignal;
+}
+
+Vector2 VirtualMotors::GetAngles()
+{
+    lock_guard<mutex> lock(_plantLock);
+    return _plant->GetAngles();
+}
+
+void VirtualMotors::Start()
+{
+    if(!_isRunning)
+    {
+        _isRunning = true;
+        _listenFuture = Executor::Instance().Submit(SERIAL_GROUP, [this]()
+        {
+            Listen();
+        });
+    }
+}
+
+void VirtualMotors::Stop()
+{
+    if(_isRunning)
+    {
+        _isRunning = false;
+        _listenFuture.wait();
+    }
+}
+
+void VirtualMotors::Update()
+{
+    // Let the plant catch up to wherever the clock is now.
+    bool arrived;
+    {
+        lock_guard<mutex> lock(_plantLock);
+        arrived = _plant->Update(_clock->NowUs());
+    }
+
+    if(arrived)
+    {
+        // The simulation only stays deterministic if tsw has the success before anybody looks for it.
+        // So hang on until the gatherer has actually picked it up, it signals every message it buffers.
+        Counter& messagesCounter = MetricsRegistry::Instance().GetCounter("serial.messages");
+        uint64_t gathered = messagesCounter.Get();
+        Send(SIM_MOTORS_SUCCESS);
+        while(_messageSignal && messagesCounter.Get() == gathered)
+        {
+            _messageSignal->Wait(SIM_GATHER_WAIT_MS);
+        }
+    }
+}
+
+void VirtualMotors::Listen()
+{
+    pollfd pfd;
+    pfd.fd = _fds[0];
+    pfd.events = POLLIN;
+    while(_isRunning)
+    {
+        if(poll(&pfd, 1, 100) <= 0)
+        {
+            continue;
+        }
+
+        unsigned char bytes[64];
+        int numRead = read(_fds[0], bytes, sizeof(bytes));
+        for(int i = 0; i < numRead; i++)
+        {
+            DeviceMessage message;
+            if(!_parser.Push(bytes[i], &message))
+            {
+                continue;
+            }
+
+            // Tsw is blocked waiting on the ack, so the clock is not moving while we do this.
+            {
+                lock_guard<mutex> lock(_plantLock);
+                _plant->ApplyCommand(message, _clock->NowUs());
+            }
+            Send(SIM_MOTORS_ACK);
+
+            // Calibration is instant in here.
+            if((message.bytes[0] & 0x0f) == tsw::io::Activate)
+            {
+                Send(SIM_MOTORS_SUCCESS);
+            }
+        }
+    }
+}
+
+void VirtualMotors::Send(unsigned char header)
+{
+    if(write(_fds[0], &header, 1) != 1)
+    {
+        Log("Virtual motors could not write to tsw", tsw::utilities::Error);
+    }
+}
+
+VirtualMotors::~VirtualMotors()
+{
+    // The other end belongs to the serial port it got attached to.
+    Stop();
+    close(_fds[0]);
+}
@@ -0,0 +1,198 @@
+#include "simulation.hpp"
+#include "settings.hpp"
+#include <iostream>
+#include <algorithm>
+#include <cmath>
+
+using namespace tsw::simulation;
+using namespace tsw::imaging;
+using namespace tsw::io::settings;
+using namespace std;
+
+int main(int argc, char* argv[])
+{
+    if(argc < 3 || argc > 4)
+    {
+        cout << "Usage: tracking_sim <stand|walk|pace|sprint|hide> <seconds> [seed]" << endl;
+        return 1;
+    }
+
+    string scenario(argv[1]);
+    int64_t durationUs = (int64_t)(atof(argv[2]) * 1000000);
+    unsigned int seed = argc > 3 ? atoi(argv[3]) : 1;
+
+    // The whole point is to try out the values in here, so use the same file tsw does.
+    string thisFile(argv[0]);
+    string startingDir = thisFile.substr(0, thisFile.find_last_of('/'));
+    TswSettings settings(startingDir + "/tsw.json");
+    ConfigureLog(tsw::utilities::Error);
+
+    // Everything below runs on our time, not the wall's.
+    VirtualClock clock;
+    Clock::SetCurrent(&clock);
+    chrono::steady_clock::time_point wallStart = chrono::steady_clock::now();
+
+    // The real motor controller talks to the fake motors over a socket instead of a serial port.
+    GimbalPlant plant(settings.PanConfig, settings.TiltConfig, settings.HomeAngles);
+    VirtualMotors motors(plant, clock);
+    motors.Start();
+    SerialPort* port = new SerialPort(B115200);
+    port->Attach(motors.GetTswFd());
+    DeviceSerialPort devicePort(*port);
+    devicePort.StartGathering();
+    motors.WatchGatherer(devicePort.GetMessageSignal(Motors));
+
+    MotorController motorController(devicePort, settings.PanConfig, settings.TiltConfig);
+    CameraMotionController motionController(motorController);
+    motionController.HomeAngles = settings.HomeAngles;
+    motionController.AngleXBounds = settings.AngleXBounds;
+    motionController.MotorSpeeds = settings.MotorSpeeds;
+    motionController.Tracker.Config = settings.TrackingConfig;
+    motionController.UseSearchTrajectory = settings.UseSearchTrajectory;
+    motionController.MotionGating = settings.MotionGating;
+    motionController.CalibrateFOV(settings.CameraFrameWidth, settings.CameraFrameHeight);
+
+    SmartOfficerLocator officerLocator(settings.OfficerClassId);
+    officerLocator.TargetRegionProportion = settings.TargetRegionProportion;
+    officerLocator.SafeRegionProportion = settings.SafeRegionProportion;
+    officerLocator.ConfidenceThreshold = settings.OfficerConfidenceThreshold;
+    officerLocator.MaxHSV = settings.MaxOfficerHSV;
+    officerLocator.MinHSV = settings.MinOfficerHSV;
+    officerLocator.OfficerThreshold = settings.OfficerThreshold;
+    officerLocator.ColorCache = settings.OfficerColorCache;
+
+    // Paint the officer right in the middle of the color range the locator is looking for.
+    int frameWidth = settings.CameraFrameWidth;
+    int frameHeight = settings.CameraFrameHeight;
+    Scalar officerHSV = (settings.MinOfficerHSV + settings.MaxOfficerHSV) / 2;
+    FrameRenderer renderer(frameWidth, frameHeight, motionController.HorizontalFov, motionController.VerticalFov, officerHSV, seed);
+    renderer.OfficerClassId = settings.OfficerClassId;
+    renderer.PixelJitter = 3;
+    renderer.MissRate = 0.02;
+    ScriptedOfficer officer = ScriptedOfficer::FromScenario(scenario, durationUs, settings.HomeAngles);
+
+    motionController.InitializeGuidance();
+    uint startMoves = plant.GetMoveCount();
+
+    // Same stand in for the region checks the locator does, so on target means the same thing to both.
+    double targetHalfWidth = settings.TargetRegionProportion.x * frameWidth / 2;
+    double targetHalfHeight = settings.TargetRegionProportion.y * frameHeight / 2;
+    int framesToSkip = settings.TrackingConfig.enabled || settings.MotionGating.enabled || settings.GuidanceRate > 0 ? 1 : max(1, settings.CameraFramesToSkipMoving);
+    int64_t frameIntervalUs = (int64_t)(1000000 / settings.CameraFrameRate);
+    int64_t startUs = clock.NowUs();
+
+    // The real control loop sleeps on the wall clock, so we tick it ourselves on the virtual one.
+    int64_t tickIntervalUs = settings.GuidanceRate > 0 ? 1000000 / settings.GuidanceRate : 0;
+    int64_t nextTickUs = startUs;
+    vector<double> errors;
+    size_t visibleFrames = 0;
+    size_t inFrameFrames = 0;
+    size_t onTargetFrames = 0;
+    size_t slewingFrames = 0;
+    size_t frameNum = 0;
+    vector<InferenceBoundingBox> rawBoxes;
+    while(clock.NowUs() - startUs < durationUs)
+    {
+        // Expose the frame with wherever the gimbal is right now.
+        motors.Update();
+        int64_t exposureUs = clock.NowUs();
+        int64_t frameUs = exposureUs - startUs;
+        Vector2 gimbalAngles = motors.GetAngles();
+        Vector2 officerAngles = officer.GetAngles(frameUs);
+        bool visible = officer.IsVisible(frameUs);
+        bool inFrame = renderer.Render(gimbalAngles, officerAngles, visible, rawBoxes);
+
+        if(visible)
+        {
+            visibleFrames++;
+            errors.push_back(hypot(officerAngles.x - gimbalAngles.x, officerAngles.y - gimbalAngles.y));
+            Vector2 pixel = renderer.ToPixel(gimbalAngles, officerAngles);
+            if(fabs(pixel.x - frameWidth / 2.0) < targetHalfWidth && fabs(pixel.y - frameHeight / 2.0) < targetHalfHeight)
+            {
+                onTargetFrames++;
+            }
+        }
+        inFrameFrames += inFrame ? 1 : 0;
+
+        // Same skipping that the image processor does.
+        bool slewing = settings.MotionGating.enabled && motionController.IsSlewing(exposureUs);
+        slewingFrames += slewing ? 1 : 0;
+        if(frameNum % framesToSkip == 0 && !slewing)
+        {
+            // By the time guidance gets the frame, the world has moved on a bit.
+            clock.Advance(SIM_PROCESSING_LATENCY_US);
+            motors.Update();
+
+            vector<OfficerInferenceBox> boxes = officerLocator.GetOfficerLocations(rawBoxes, frameWidth, frameHeight);
+            OfficerInferenceBox* bestBox = officerLocator.GetDesiredOfficerBox(boxes, renderer.GetFrame());
+            OfficerDirection dir = officerLocator.FindOfficer(bestBox, frameWidth, frameHeight);
+            if(tickIntervalUs > 0)
+            {
+                motionController.SubmitTarget(dir, exposureUs);
+            }
+            else
+            {
+                motionController.GuideCameraTo(dir, exposureUs);
+            }
+            delete bestBox;
+        }
+
+        frameNum++;
+        int64_t nextFrameUs = startUs + frameNum * frameIntervalUs;
+        while(tickIntervalUs > 0 && nextTickUs < nextFrameUs)
+        {
+            if(nextTickUs > clock.NowUs())
+            {
+                clock.Advance(nextTickUs - clock.NowUs());
+            }
+
+            motors.Update();
+            motionController.ControlTick();
+            nextTickUs += tickIntervalUs;
+        }
+
+        if(nextFrameUs > clock.NowUs())
+        {
+            clock.Advance(nextFrameUs - clock.NowUs());
+        }
+    }
+
+    uint moves = plant.GetMoveCount() - startMoves;
+    motionController.UninitializeGuidance();
+    devicePort.StopGathering();
+    motors.Stop();
+    Clock::SetCurrent(nullptr);
+    double wallSeconds = chrono::duration<double>(chrono::steady_clock::now() - wallStart).count();
+    double simSeconds = durationUs / 1000000.0;
+
+    sort(errors.begin(), errors.end());
+    double meanError = 0;
+    for(double error : errors)
+    {
+        meanError += error;
+    }
+    meanError = errors.empty() ? 0 : meanError / errors.size();
+    auto errorAt = [&errors](double prop)
+    {
+        return errors.empty() ? 0 : errors[min(errors.size() - 1, (size_t)(prop * errors.size()))];
+    };
+
+    // One json line per run, so sweeps over the settings can just be appended together.
+    cout << "{\"scenario\":\"" << scenario << "\",\"seed\":" << seed << ",\"sim_seconds\":" << simSeconds << ",\"wall_seconds\":" << wallSeconds
+        << ",\"speedup\":" << (wallSeconds > 0 ? simSeconds / wallSeconds : 0)
+        << ",\"target_region\":[" << settings.TargetRegionProportion.x << "," << settings.TargetRegionProportion.y << "]"
+        << ",\"safe_region\":[" << settings.SafeRegionProportion.x << "," << settings.SafeRegionProportion.y << "]"
+        << ",\"frames_to_skip\":" << framesToSkip
+        << ",\"guidance_rate\":" << settings.GuidanceRate
+        << ",\"tracker\":" << (settings.TrackingConfig.enabled ? "true" : "false")
+        << ",\"motion_gating\":" << (settings.MotionGating.enabled ? "true" : "false")
+        << ",\"slewing_frames\":" << slewingFrames
+        << ",\"motor_speeds\":[" << (int)settings.MotorSpeeds.x << "," << (int)settings.MotorSpeeds.y << "]"
+        << ",\"frames\":" << frameNum
+        << ",\"error_deg\":{\"mean\":" << meanError << ",\"p50\":" << errorAt(0.5) << ",\"p95\":" << errorAt(0.95) << ",\"max\":" << errorAt(1) << "}"
+        << ",\"time_in_frame\":" << (visibleFrames ? inFrameFrames / (double)visibleFrames : 0)
+        << ",\"time_on_target\":" << (visibleFrames ? onTargetFrames / (double)visibleFrames : 0)
+        << ",\"move_commands\":" << moves << ",\"commands_per_second\":" << moves / simSeconds << "}" << endl;
+
+    return 0;
+}
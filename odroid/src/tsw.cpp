@@ -3,6 +3,9 @@
 #include "Spinnaker.h"
 #include "utilities.hpp"
 #include <fstream>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <signal.h>
 #include "settings.hpp"
     
 using namespace tsw::imaging;
@@ -10,56 +13,73 @@ using namespace tsw::io;
 using namespace tsw::io::settings;
 using namespace tsw::utilities;
 
-DeviceSerialPort* ConnectToSerialPort(string serialPath, speed_t baudRate)
+// Keeps at it until the device shows up, then lets whoever is waiting on it know.
+void ConnectWithBackoff(string deviceName, int64_t bootUs, EventSignal& ready, function<void()> connect)
 {
-    SerialPort* rawCommandPort = new SerialPort(baudRate);
+    Backoff backoff(STARTUP_BACKOFF_INITIAL_MS, STARTUP_BACKOFF_MAX_MS);
     while(true)
     {
         try
         {
-            Log("Opening device serial port on path " + serialPath, Debug | DeviceSerial);
-            rawCommandPort->Open(serialPath);
-            Log("Device serial port opened", Information | DeviceSerial);
-            return new DeviceSerialPort(*rawCommandPort);
+            connect();
+            break;
         }
-        catch(exception e)
+        catch(exception& e)
         {
-            Log("Could not open serial port", tsw::utilities::Error); 
+            Log("Could not connect to " + deviceName + ". " + string(e.what()), tsw::utilities::Error);
         }
 
         // Wait a bit before connecting again.
-        sleep(5);
+        int delayMs = backoff.NextDelayMs();
+        Log("Trying " + deviceName + " again in " + to_string(delayMs) + "ms", Debug);
+        this_thread::sleep_for(chrono::milliseconds(delayMs));
     }
+
+    MetricsRegistry::Instance().GetGauge("startup." + deviceName + "_ready_us").Set(GetMonotonicTimeUs() - bootUs);
+    ready.Notify();
 }
 
-FlirCamera* ConnectToCamera(TswSettings& settings)
+void ConnectToSerialPort(string deviceName, SerialConfig config, int64_t bootUs, DeviceSerialPort** devicePort, EventSignal& ready)
 {
-    FlirCamera* camera = new FlirCamera(settings.CameraBufferCount);
-    while(true)
+    // Same raw port every try, it just keeps trying to open the path.
+    SerialPort* rawCommandPort = new SerialPort(config.baudRate, config.lowLatency);
+    ConnectWithBackoff(deviceName, bootUs, ready, [&]()
     {
-        try
-        {
-            Log("Connecting to camera " + settings.CameraSerialNumber, Debug);
-            camera->Connect(settings.CameraSerialNumber);
-
-            // Configuring the camera is now part of the setup.
-            Log("Setting camera parameters", Debug);
-            camera->SetFrameHeight(settings.CameraFrameHeight);
-            camera->SetFrameWidth(settings.CameraFrameWidth);
-            camera->SetFrameRate(settings.CameraFrameRate);
-            Log("Camera parameters set", Debug);
-
-            Log("Camera connected", Information);
-            return camera;
-        }
-        catch(exception e)
+        Log("Opening device serial port on path " + config.path, Debug | DeviceSerial);
+        rawCommandPort->Open(config.path);
+        Log("Device serial port opened", Information | DeviceSerial);
+        *devicePort = new DeviceSerialPort(*rawCommandPort);
+    });
+}
+
+void ConnectToCamera(TswSettings& settings, int64_t bootUs, FlirCamera** connectedCamera, EventSignal& ready)
+{
+    // Getting spinnaker going is slow too, so it happens off of the main thread with the rest of it.
+    // It can fail just like connecting can, and then it gets retried (and logged) the same way.
+    FlirCamera* camera = nullptr;
+    ConnectWithBackoff("camera", bootUs, ready, [&]()
+    {
+        if(!camera)
         {
-            Log("Could not connect to camera. " + string(e.what()), tsw::utilities::Error);
+            camera = new FlirCamera(settings.CameraBufferCount);
         }
 
-        // Wait a bit before connecting again.
-        sleep(5);
-    }
+        Log("Connecting to camera " + settings.CameraSerialNumber, Debug);
+        camera->Connect(settings.CameraSerialNumber);
+
+        // Configuring the camera is now part of the setup.
+        // All in one go, so only what actually needs to change gets sent.
+        Log("Setting camera parameters", Debug);
+        camera->BeginConfiguration();
+        camera->SetFrameHeight(settings.CameraFrameHeight);
+        camera->SetFrameWidth(settings.CameraFrameWidth);
+        camera->SetFrameRate(settings.CameraFrameRate);
+        camera->CommitConfiguration();
+        Log("Camera parameters set", Debug);
+
+        Log("Camera connected", Information);
+        *connectedCamera = camera;
+    });
 }
 
 void PrintFile(string fileName)
@@ -75,7 +95,7 @@ void PrintFile(string fileName)
     fs.close();
 }
 
-void RunOfficerTracking(CameraMotionController& motionController, FlirCamera* camera, ImageProcessor& imageProcessor, TswSettings& settings)
+void RunOfficerTracking(FlirCamera* camera, ImageProcessor& imageProcessor, FrameRateGovernor& governor, TswSettings& settings)
 {
     Log("Starting officer tracking", Information | DeviceSerial | Recording | Officers);
 
@@ -83,14 +103,22 @@ void RunOfficerTracking(CameraMotionController& motionController, FlirCamera* ca
     if(settings.ImagingConfig.moveCamera || settings.ImagingConfig.recordFrames || settings.ImagingConfig.displayFrames)
     {
         // Start the processing first so that everything is setup for when we get the first frame.
+        // If the feed was kept warm, it just has to speed back up.
         imageProcessor.StartProcessing();
+        camera->ExitStandby();
         camera->StartLiveFeed();
+
+        // Only runs while we track, standby has its own rate.
+        if(settings.FrameRateGovernor.enabled)
+        {
+            governor.Start();
+        }
     }
     
     Log("Officer tracking started", Information | DeviceSerial | Recording | Officers);
 }
 
-void FinishOfficerTracking(CameraMotionController& motionController, FlirCamera* camera, ImageProcessor& imageProcessor, TswSettings& settings, StatusLED& led)
+void FinishOfficerTracking(FlirCamera* camera, ImageProcessor& imageProcessor, FrameRateGovernor& governor, TswSettings& settings, StatusLED& led)
 {
     Log("Stopping officer tracking", Information | DeviceSerial | Recording | Officers);
 
@@ -98,16 +126,91 @@ void FinishOfficerTracking(CameraMotionController& motionController, FlirCamera*
     {
         // Start the processing first so that everything is setup for when we get the first frame.
         led.FlashesPerPause = 4;
+        governor.Stop();
         imageProcessor.StopProcessing();
         led.FlashesPerPause = 5;
-        camera->StopLiveFeed();
+
+        // Standby keeps the stream going slow, so the next start has exposure already figured out.
+        if(settings.CameraStandbyFrameRate > 0)
+        {
+            camera->EnterStandby(settings.CameraStandbyFrameRate);
+        }
+        else
+        {
+            camera->StopLiveFeed();
+        }
     }
 
     Log("Officer tracking stopped", Information | DeviceSerial | Recording | Officers);
+    Log(ThreadRegistry::Instance().BuildCoreReport(), Debug);
+}
+
+void ToggleTracing(TswSettings& settings, EventReactor& reactor)
+{
+    static uint traceNum = 0;
+    static uint stopTimerKey = 0;
+    static bool hasStopTimer = false;
+    Tracer& tracer = Tracer::Instance();
+
+    if(hasStopTimer)
+    {
+        reactor.Remove(stopTimerKey);
+        hasStopTimer = false;
+    }
+
+    if(tracer.IsTracing())
+    {
+        tracer.Stop();
+        tracer.WriteChromeTrace(settings.TracePath + "_" + to_string(traceNum++) + ".json");
+    }
+    else
+    {
+        tracer.Start();
+
+        // If we have a duration, the capture ends itself so nobody has to send a second signal.
+        if(settings.TraceDuration > 0)
+        {
+            stopTimerKey = reactor.AddTimer(settings.TraceDuration * 1000, [&settings, &reactor]()
+            {
+                ToggleTracing(settings, reactor);
+            }, false);
+            hasStopTimer = true;
+        }
+    }
+}
+
+void HandleCommand(Command* command, FlirCamera* camera, ImageProcessor& imageProcessor, FrameRateGovernor& governor, TswSettings& settings, StatusLED& led)
+{
+    // See what the command wants us to do.
+    switch(command->action)
+    {
+        case StartOfficerTracking:
+            // A slower pause will have us writing less to the disk to max processing on the images.
+            led.FlashesPerPause = 1;
+            led.PauseTime = 2000000;
+            RunOfficerTracking(camera, imageProcessor, governor, settings);                    
+            break;
+
+        case StopOfficerTracking:
+            // Decreae the super long pause.
+            led.PauseTime = 750000;
+            FinishOfficerTracking(camera, imageProcessor, governor, settings, led);
+            led.FlashesPerPause = 3;
+            break;
+
+        case SendKeyword:
+            Log("Received Keyword: " + string(command->args.begin(), command->args.end()), Information);
+            break;
+
+        default:
+            Log("Unimplemented command " + to_string(command->action), tsw::utilities::Error | DeviceSerial);
+    }
 }
 
 int main(int argc, char* argv[])
 {
+    int64_t bootUs = GetMonotonicTimeUs();
+
     // Initialize the settings.
     // I wish we could do this after setting up the led, but we need the settings to set it up lol.
     string thisFile(argv[0]);
@@ -117,6 +220,24 @@ int main(int argc, char* argv[])
     TswSettings settings(settingsFile);
     Log("Settings loaded", Information);    
 
+    // Tracing gets toggled with SIGUSR1. Block it before any threads start so only the reactor ever sees it.
+    sigset_t traceSignals;
+    sigemptyset(&traceSignals);
+    sigaddset(&traceSignals, SIGUSR1);
+    pthread_sigmask(SIG_BLOCK, &traceSignals, nullptr);
+
+    // The threads need to know where to run before anybody starts them.
+    for(auto& threadConfig : settings.ThreadConfigs)
+    {
+        Executor::Instance().ConfigureGroup(threadConfig.first, threadConfig.second);
+    }
+
+    // Keep the control loop from ever waiting on a page fault.
+    if(settings.LockMemory && mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        Log("Could not lock process memory", tsw::utilities::Error);
+    }
+
     // Setup the led as early as possible.
     StatusLED led(settings.StatusLEDFile);
     led.SetEnabled(settings.UseStatusLED);
@@ -129,36 +250,42 @@ int main(int argc, char* argv[])
     PrintFile(settingsFile);
     ConfigureLog(settings.LogFlags);
 
-    // Connect to the device port.
-    DeviceSerialPort* portThatCanTalkToMotors;
-    CommandAgent* agent;
-    if(settings.UseDeviceAdapter)
+    if(settings.MetricsInterval > 0)
     {
-        portThatCanTalkToMotors = ConnectToSerialPort(settings.DeviceSerialConfig.path, settings.DeviceSerialConfig.baudRate);
-        agent = new CommandAgent(*portThatCanTalkToMotors);
+        MetricsRegistry::Instance().StartReporting(settings.MetricsPath, settings.MetricsInterval);
     }
-    else
+
+    // Opencv gets our compute pool instead of spinning up its own threads on top of ours.
+    cv::parallel::setParallelForBackend(make_shared<ExecutorParallelBackend>(Executor::Instance().GetComputePool()));
+
+    // None of the devices need each other to connect, so they all get going at once.
+    // Whoever needs one just waits on its ready signal, instead of everybody waiting on the slowest one.
+    DeviceSerialPort* portThatCanTalkToMotors = nullptr;
+    DeviceSerialPort* handheldPort = nullptr;
+    FlirCamera* camera = nullptr;
+    EventSignal motorsReady;
+    EventSignal handheldReady;
+    EventSignal cameraReady;
+    Executor::Instance().Submit(SERIAL_GROUP, [&]()
     {
-        portThatCanTalkToMotors = ConnectToSerialPort(settings.MotorsSerialConfig.path, settings.MotorsSerialConfig.baudRate);
-        DeviceSerialPort* handheldPort = ConnectToSerialPort(settings.HandheldSerialConfig.path, settings.HandheldSerialConfig.baudRate);
-        handheldPort->StartGathering();
-        agent = new CommandAgent(*handheldPort);
+        ConnectToSerialPort("motors", settings.UseDeviceAdapter ? settings.DeviceSerialConfig : settings.MotorsSerialConfig, bootUs, &portThatCanTalkToMotors, motorsReady);
+    });
+    if(!settings.UseDeviceAdapter)
+    {
+        Executor::Instance().Submit(SERIAL_GROUP, [&]()
+        {
+            ConnectToSerialPort("handheld", settings.HandheldSerialConfig, bootUs, &handheldPort, handheldReady);
+        });
     }
+    Executor::Instance().Submit(ACQUISITION_GROUP, [&]()
+    {
+        ConnectToCamera(settings, bootUs, &camera, cameraReady);
+    });
 
+    // Everything motion related only needs the motors.
+    motorsReady.Wait();
     portThatCanTalkToMotors->StartGathering();
 
-    // Serial port setup is done.
-    led.FlashesPerPause = 2;
-
-    // Connect to the camera and attach the recorder and display window.
-    FlirCamera* camera = ConnectToCamera(settings);    
-
-    Size frameSize;
-    frameSize.height = camera->GetFrameHeight();
-    frameSize.width = camera->GetFrameWidth();
-    Recorder recorder(frameSize, camera->GetFrameRate());
-    DisplayWindow window("Officer Footage", settings.FrameDisplayRefreshRate);
-
     // Setup the motion control.
     SmartOfficerLocator officerLocator(settings.OfficerClassId);
     officerLocator.TargetRegionProportion = settings.TargetRegionProportion;
@@ -167,6 +294,7 @@ int main(int argc, char* argv[])
     officerLocator.MaxHSV = settings.MaxOfficerHSV;
     officerLocator.MinHSV = settings.MinOfficerHSV;
     officerLocator.OfficerThreshold = settings.OfficerThreshold;
+    officerLocator.ColorCache = settings.OfficerColorCache;
 
     // These two guys will handle moving the system.
     MotorController motorController(*portThatCanTalkToMotors, settings.PanConfig, settings.TiltConfig);
@@ -174,62 +302,118 @@ int main(int argc, char* argv[])
     motionController.HomeAngles = settings.HomeAngles;
     motionController.AngleXBounds = settings.AngleXBounds;
     motionController.MotorSpeeds = settings.MotorSpeeds;
+    motionController.Tracker.Config = settings.TrackingConfig;
+    motionController.GuidanceRate = settings.GuidanceRate;
+    motionController.UseSearchTrajectory = settings.UseSearchTrajectory;
+    motionController.MotionGating = settings.MotionGating;
+    motionController.ArmedStandby = settings.ArmedStandby;
 
     // The FOV changes based on the resolution.
     motionController.CalibrateFOV(settings.CameraFrameWidth, settings.CameraFrameHeight);
 
+    // Get the motors calibrated while we wait, so starting to track doesn't have to.
+    if(settings.ArmedStandby && settings.ImagingConfig.moveCamera)
+    {
+        motionController.ArmGuidance();
+    }
+
+    // Commands come in through the adapter if we have one, otherwise the handheld has its own port.
+    CommandAgent* agent;
+    if(settings.UseDeviceAdapter)
+    {
+        agent = new CommandAgent(*portThatCanTalkToMotors);
+    }
+    else
+    {
+        handheldReady.Wait();
+        handheldPort->StartGathering();
+        agent = new CommandAgent(*handheldPort);
+    }
+
+    // Serial port setup is done.
+    led.FlashesPerPause = 2;
+
+    // Attach the recorder and display window once the camera shows up.
+    cameraReady.Wait();
+    Size frameSize;
+    frameSize.height = camera->GetFrameHeight();
+    frameSize.width = camera->GetFrameWidth();
+    Recorder recorder(frameSize, camera->GetFrameRate());
+    DisplayWindow window("Officer Footage", settings.FrameDisplayRefreshRate);
+
     // This will handle displaying and recording when we get images.
     ImageProcessor imageProcessor(window, *camera, officerLocator, motionController, settings.ImagingConfig);
-    imageProcessor.CameraFramesToSkip = settings.CameraFramesToSkipMoving;
+    // The tracker does its best with every frame it can get.
+    // Same with gating, since it knows which frames were taken mid move instead of guessing.
+    imageProcessor.CameraFramesToSkip = settings.TrackingConfig.enabled || settings.MotionGating.enabled ? 1 : settings.CameraFramesToSkipMoving;
+    imageProcessor.AdaptiveReadout = settings.AdaptiveReadout;
+
+    // Keeps the frame rate at what we can actually handle, the configured one is just where it starts.
+    FrameRateGovernor governor(*camera, settings.FrameRateGovernor, settings.CameraFrameRate);
+
+    // Warm the camera up too, so the first frames we track with aren't still settling.
+    if(settings.CameraStandbyFrameRate > 0)
+    {
+        camera->EnterStandby(settings.CameraStandbyFrameRate);
+    }
 
     // This will mark that we are just chilling.
     led.FlashesPerPause = 3;
+    int64_t readyUs = GetMonotonicTimeUs() - bootUs;
+    MetricsRegistry::Instance().GetGauge("startup.boot_to_ready_us").Set(readyUs);
+    Log("Ready " + to_string(readyUs / 1000) + "ms after starting", Information);
 
     // Now here comes the actual processing.
-    // For now, if it messes up, we will just display an error and 
-    try
+    // The reactor sleeps until the handheld sends us something, then we handle every command that came in.
+    EventReactor reactor;
+    reactor.AddSignal(agent->GetCommandSignal(Handheld), [&]()
     {
-        while(true)
+        Command* command;
+        while(agent->TryReadCommand(Handheld, &command))
         {
-            // Read a command from the handheld device and acknowledge it.
-            Log("Waiting for command", Information | DeviceSerial);
-            Command* command = agent->ReadCommand(Handheld);
             agent->AcknowledgeReceived(Handheld);
-
-            // See what the command wants us to do.
-            switch(command->action)
-            {
-                case StartOfficerTracking:
-                    // A slower pause will have us writing less to the disk to max processing on the images.
-                    led.FlashesPerPause = 1;
-                    led.PauseTime = 2000000;
-                    RunOfficerTracking(motionController, camera, imageProcessor, settings);                    
-                    break;
-
-                case StopOfficerTracking:
-                    // Decreae the super long pause.
-                    led.PauseTime = 750000;
-                    FinishOfficerTracking(motionController, camera, imageProcessor, settings, led);
-                    led.FlashesPerPause = 3;
-                    break;
-
-                case SendKeyword:
-                    Log("Received Keyword: " + string(command->args.begin(), command->args.end()), Information);
-                    break;
-
-                default:
-                    Log("Unimplemented command " + to_string(command->action), tsw::utilities::Error | DeviceSerial);
-            }
+            HandleCommand(command, camera, imageProcessor, governor, settings, led);
 
             // Gotta dealocate!
             delete command;
         }
+
+        Log("Waiting for command", Information | DeviceSerial);
+    });
+
+    // Keep track of where all of our threads end up running.
+    if(settings.ThreadSampleInterval > 0)
+    {
+        reactor.AddTimer(settings.ThreadSampleInterval * 1000, []()
+        {
+            ThreadRegistry::Instance().Sample();
+        });
+    }
+
+    // kill -USR1 starts a trace capture, and a second one (or the duration running out) writes it.
+    int traceSignalFd = signalfd(-1, &traceSignals, SFD_NONBLOCK | SFD_CLOEXEC);
+    reactor.AddReader(traceSignalFd, [&]()
+    {
+        signalfd_siginfo info;
+        while(read(traceSignalFd, &info, sizeof(info)) == sizeof(info))
+        {
+            ToggleTracing(settings, reactor);
+        }
+    });
+
+    // For now, if it messes up, we will just display an error and 
+    try
+    {
+        // Commands may have come in before we registered with the reactor.
+        agent->GetCommandSignal(Handheld).Notify();
+        reactor.Run();
     }
-    catch(exception ex)
+    catch(const exception& ex)
     {
         Log("An error occured:\n" + string(ex.what()), tsw::utilities::Error);
     }
     
+    governor.Stop();
     if(camera->IsLiveFeedOn())
     {
         camera->StopLiveFeed();
@@ -239,7 +423,17 @@ int main(int argc, char* argv[])
     {
         imageProcessor.StopProcessing();
     }
+
+    // Standby leaves the motors on between runs, but not after we are gone.
+    motionController.DisarmGuidance();
     
+    if(Tracer::Instance().IsTracing())
+    {
+        Tracer::Instance().Stop();
+        Tracer::Instance().WriteChromeTrace(settings.TracePath + "_final.json");
+    }
+
+    close(traceSignalFd);
     delete agent;
     delete camera;
 
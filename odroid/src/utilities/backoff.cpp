@@ -0,0 +1,29 @@
+#include "utilities.hpp"
+
+using namespace tsw::utilities;
+
+Backoff::Backoff(int initialMs, int maxMs) : _rng(random_device()())
+{
+    _initialMs = initialMs;
+    _maxMs = maxMs;
+    _attempt = 0;
+}
+
+int Backoff::NextDelayMs()
+{
+    // Double every time until we hit the max. Once we are there, stop counting so the shift can't overflow.
+    int ceilingMs = (int)min<int64_t>(_maxMs, (int64_t)_initialMs << _attempt);
+    if(ceilingMs < _maxMs)
+    {
+        _attempt++;
+    }
+
+    // Half of it is random, so a bunch of things that failed together don't all retry together.
+    uniform_int_distribution<int> jitter(0, ceilingMs / 2);
+    return ceilingMs - ceilingMs / 2 + jitter(_rng);
+}
+
+void Backoff::Reset()
+{
+    _attempt = 0;
+}
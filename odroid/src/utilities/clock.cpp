@@ -0,0 +1,47 @@
+#include "utilities.hpp"
+#include <chrono>
+
+using namespace tsw::utilities;
+using namespace std;
+
+SystemClock _systemClock;
+atomic<Clock*> _currentClock(&_systemClock);
+
+Clock& Clock::Current()
+{
+    return *_currentClock.load(memory_order_acquire);
+}
+
+void Clock::SetCurrent(Clock* clock)
+{
+    // Null puts us back on the real clock.
+    _currentClock.store(clock ? clock : &_systemClock, memory_order_release);
+}
+
+int64_t SystemClock::NowUs()
+{
+    return chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+VirtualClock::VirtualClock(int64_t startUs)
+{
+    _nowUs = startUs;
+}
+
+int64_t VirtualClock::NowUs()
+{
+    return _nowUs.load(memory_order_acquire);
+}
+
+void VirtualClock::Advance(int64_t us)
+{
+    // Time only moves when whoever owns this clock says so.
+    _nowUs.fetch_add(us, memory_order_acq_rel);
+}
+
+int64_t GetMonotonicTimeUs()
+{
+    // Everything that compares times across threads (and against the camera) uses this clock.
+    // The simulator swaps in a virtual one so it can run faster than real time.
+    return Clock::Current().NowUs();
+}
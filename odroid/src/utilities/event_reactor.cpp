@@ -0,0 +1,185 @@
+#include "utilities.hpp"
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#define MAX_REACTOR_EVENTS 16
+
+using namespace tsw::utilities;
+using namespace std;
+
+EventReactor::EventReactor()
+{
+    _epoll = epoll_create1(EPOLL_CLOEXEC);
+    if(_epoll < 0)
+    {
+        throw runtime_error("Could not create event reactor.");
+    }
+
+    _isRunning = false;
+    _nextKey = 1;
+    _handlersLock.Name = "RCT";
+
+    // Key 0 is reserved for waking ourselves up when we get stopped.
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = 0;
+    epoll_ctl(_epoll, EPOLL_CTL_ADD, _stopSignal.GetFd(), &ev);
+}
+
+uint EventReactor::AddReader(int fd, function<void()> callback)
+{
+    return AddHandler(Reader, fd, callback);
+}
+
+uint EventReactor::AddSignal(EventSignal& signal, function<void()> callback)
+{
+    return AddHandler(Signal, signal.GetFd(), callback);
+}
+
+uint EventReactor::AddTimer(uint intervalUs, function<void()> callback, bool repeat)
+{
+    int fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if(fd < 0)
+    {
+        throw runtime_error("Could not create reactor timer.");
+    }
+
+    itimerspec spec = { };
+    spec.it_value.tv_sec = intervalUs / 1000000;
+    spec.it_value.tv_nsec = (intervalUs % 1000000) * 1000;
+    if(repeat)
+    {
+        spec.it_interval = spec.it_value;
+    }
+    timerfd_settime(fd, 0, &spec, nullptr);
+
+    return AddHandler(Timer, fd, callback);
+}
+
+uint EventReactor::AddHandler(HandlerType type, int fd, function<void()> callback)
+{
+    _handlersLock.Lock("Add Handler");
+    uint key = _nextKey++;
+    Handler handler;
+    handler.type = type;
+    handler.fd = fd;
+    handler.callback = callback;
+    _handlers[key] = handler;
+
+    epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.u32 = key;
+    int res = epoll_ctl(_epoll, EPOLL_CTL_ADD, fd, &ev);
+    _handlersLock.Unlock("Add Handler");
+
+    if(res != 0)
+    {
+        Remove(key);
+        throw runtime_error("Could not register file descriptor " + to_string(fd) + " with reactor.");
+    }
+
+    return key;
+}
+
+void EventReactor::Remove(uint key)
+{
+    _handlersLock.Lock("Remove Handler");
+    auto found = _handlers.find(key);
+    if(found != _handlers.end())
+    {
+        epoll_ctl(_epoll, EPOLL_CTL_DEL, found->second.fd, nullptr);
+
+        // We made the timer descriptors, so we have to clean them up.
+        if(found->second.type == Timer)
+        {
+            close(found->second.fd);
+        }
+
+        _handlers.erase(found);
+    }
+    _handlersLock.Unlock("Remove Handler");
+}
+
+void EventReactor::Run()
+{
+    _isRunning = true;
+    while(IsRunning())
+    {
+        RunOnce();
+    }
+}
+
+bool EventReactor::RunOnce(int timeoutMs)
+{
+    epoll_event events[MAX_REACTOR_EVENTS];
+    int numEvents = epoll_wait(_epoll, events, MAX_REACTOR_EVENTS, timeoutMs);
+    if(numEvents < 0)
+    {
+        if(errno == EINTR)
+        {
+            return false;
+        }
+
+        throw runtime_error("Reactor failed waiting for events.");
+    }
+
+    for(int i = 0; i < numEvents; i++)
+    {
+        uint key = events[i].data.u32;
+        if(key == 0)
+        {
+            _stopSignal.Clear();
+            continue;
+        }
+
+        // Grab a copy of the handler so that the callback can add/remove handlers without deadlocking us.
+        _handlersLock.Lock("Dispatch");
+        auto found = _handlers.find(key);
+        if(found == _handlers.end())
+        {
+            // It got removed by an earlier callback this round.
+            _handlersLock.Unlock("Dispatch");
+            continue;
+        }
+        Handler handler = found->second;
+        _handlersLock.Unlock("Dispatch");
+
+        // Signals and timers have to be drained or epoll will keep telling us about them.
+        if(handler.type == Timer || handler.type == Signal)
+        {
+            uint64_t count;
+            read(handler.fd, &count, sizeof(count));
+        }
+
+        handler.callback();
+    }
+
+    return numEvents > 0;
+}
+
+void EventReactor::Stop()
+{
+    _isRunning = false;
+    _stopSignal.Notify();
+}
+
+bool EventReactor::IsRunning()
+{
+    return _isRunning;
+}
+
+EventReactor::~EventReactor()
+{
+    _handlersLock.Lock("Destroy");
+    for(auto& handler : _handlers)
+    {
+        if(handler.second.type == Timer)
+        {
+            close(handler.second.fd);
+        }
+    }
+    _handlers.clear();
+    _handlersLock.Unlock("Destroy");
+    close(_epoll);
+}
@@ -0,0 +1,78 @@
+#include "utilities.hpp"
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace tsw::utilities;
+using namespace std;
+
+EventSignal::EventSignal()
+{
+    // Non-blocking so that clearing an unset signal does not hang us up.
+    _fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if(_fd < 0)
+    {
+        throw runtime_error("Could not create event signal.");
+    }
+
+    _generation = 0;
+    _consumedGeneration = 0;
+}
+
+void EventSignal::Notify()
+{
+    {
+        lock_guard<mutex> lock(_lock);
+        _generation++;
+    }
+    _condition.notify_all();
+
+    // The reactor watches the fd instead, and drains it itself.
+    uint64_t one = 1;
+    write(_fd, &one, sizeof(one));
+}
+
+bool EventSignal::Wait(int timeoutMs)
+{
+    // Every waiter that was here when the notify happened gets woken up, not just whoever got there first.
+    // A notify that nobody was waiting for is still held on to for the next one that comes along.
+    unique_lock<mutex> lock(_lock);
+    uint64_t startGeneration = _generation;
+    auto isNotified = [this, startGeneration]()
+    {
+        return _generation != startGeneration || _generation != _consumedGeneration;
+    };
+
+    if(timeoutMs < 0)
+    {
+        _condition.wait(lock, isNotified);
+    }
+    else if(!_condition.wait_for(lock, chrono::milliseconds(timeoutMs), isNotified))
+    {
+        // Timed out.
+        return false;
+    }
+
+    _consumedGeneration = _generation;
+    return true;
+}
+
+void EventSignal::Clear()
+{
+    {
+        lock_guard<mutex> lock(_lock);
+        _consumedGeneration = _generation;
+    }
+
+    uint64_t count;
+    read(_fd, &count, sizeof(count));
+}
+
+int EventSignal::GetFd()
+{
+    return _fd;
+}
+
+EventSignal::~EventSignal()
+{
+    close(_fd);
+}
@@ -0,0 +1,160 @@
+#include "utilities.hpp"
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+using namespace tsw::utilities;
+using namespace std;
+
+Executor& Executor::Instance()
+{
+    // This is never deleted on purpose. Subsystem loops may still be running when the statics get torn down.
+    static Executor* instance = new Executor();
+    return *instance;
+}
+
+Executor::Executor()
+{
+    // Getting frames in and moving the motors are what matter. Everything else can wait.
+    AddGroup(ACQUISITION_GROUP, HighPriority);
+    AddGroup(GUIDANCE_GROUP, HighPriority);
+    AddGroup(SERIAL_GROUP, HighPriority);
+    AddGroup(DISPLAY_GROUP, LowPriority);
+    AddGroup(ENCODING_GROUP, LowPriority);
+    AddGroup(STATUS_GROUP, LowPriority);
+
+    // The caller of a parallel for helps out, so we leave it a core.
+    int numCores = max(1, (int)thread::hardware_concurrency());
+    _computePool = new StealingPool(COMPUTE_GROUP, NormalPriority, max(1, numCores - 1));
+}
+
+void Executor::AddGroup(string name, PriorityClass priority)
+{
+    lock_guard<mutex> lock(_groupsLock);
+    if(_groups.find(name) == _groups.end())
+    {
+        _groups[name] = new WorkerGroup(name, priority);
+    }
+    else
+    {
+        _groups[name]->Priority = priority;
+    }
+}
+
+void Executor::ConfigureGroup(string name, ThreadConfig config)
+{
+    if(name == COMPUTE_GROUP)
+    {
+        _computePool->Configure(config);
+        return;
+    }
+
+    GetGroup(name).Configure(config);
+}
+
+WorkerGroup& Executor::GetGroup(string name)
+{
+    lock_guard<mutex> lock(_groupsLock);
+    auto found = _groups.find(name);
+    if(found == _groups.end())
+    {
+        // Anything we haven't heard of just gets normal treatment.
+        _groups[name] = new WorkerGroup(name, NormalPriority);
+        return *_groups[name];
+    }
+
+    return *found->second;
+}
+
+future<void> Executor::Submit(string groupName, function<void()> task)
+{
+    return GetGroup(groupName).Submit(task);
+}
+
+void Executor::ParallelFor(int start, int end, function<void(int, int)> body)
+{
+    _computePool->ParallelFor(start, end, body);
+}
+
+StealingPool& Executor::GetComputePool()
+{
+    return *_computePool;
+}
+
+pid_t InitializeWorkerThread(string threadName, PriorityClass priority, ThreadConfig config)
+{
+    // Linux only allows 15 characters for the name.
+    pthread_setname_np(pthread_self(), threadName.substr(0, 15).c_str());
+
+    pid_t threadId = syscall(SYS_gettid);
+    ThreadRegistry::Instance().Register(threadName, threadId);
+    ApplyThreadSettings(threadId, threadName, priority, config);
+    return threadId;
+}
+
+void ApplyThreadSettings(pid_t threadId, string threadName, PriorityClass priority, ThreadConfig config)
+{
+    // Pin the thread to the cores it was given, if any.
+    if(!config.cpus.empty())
+    {
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        for(int cpu : config.cpus)
+        {
+            CPU_SET(cpu, &cpus);
+        }
+
+        if(sched_setaffinity(threadId, sizeof(cpus), &cpus) != 0)
+        {
+            Log("Could not set cpu affinity of thread " + threadName, tsw::utilities::Error);
+        }
+    }
+
+    // Real time threads don't care about nice values, they just always beat everybody else.
+    if(config.fifoPriority > 0)
+    {
+        sched_param param;
+        param.sched_priority = config.fifoPriority;
+        if(sched_setscheduler(threadId, SCHED_FIFO, &param) != 0)
+        {
+            Log("Could not make thread " + threadName + " real time with priority " + to_string(config.fifoPriority), tsw::utilities::Error);
+        }
+        return;
+    }
+
+    // The thread might have been real time before it got this config, and the nice value means nothing until it isn't.
+    sched_param param;
+    param.sched_priority = 0;
+    if(sched_setscheduler(threadId, SCHED_OTHER, &param) != 0)
+    {
+        Log("Could not take thread " + threadName + " off of real time", tsw::utilities::Error);
+    }
+
+    int niceValue;
+    switch(priority)
+    {
+        case HighPriority:
+            niceValue = -10;
+            break;
+
+        case LowPriority:
+            niceValue = 10;
+            break;
+
+        default:
+            niceValue = 0;
+    }
+
+    // Nice values are per thread on linux, so this only affects us.
+    if(setpriority(PRIO_PROCESS, threadId, niceValue) != 0)
+    {
+        Log("Could not set priority of thread " + threadName + " to " + to_string(niceValue), Debug);
+    }
+}
+
+void FinishWorkerThread(pid_t threadId)
+{
+    ThreadRegistry::Instance().Unregister(threadId);
+}
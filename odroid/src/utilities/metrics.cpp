@@ -0,0 +1,331 @@
+#include "utilities.hpp"
+#include <sstream>
+#include <fstream>
+#include <cstring>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+using namespace tsw::utilities;
+using namespace std;
+
+Counter::Counter()
+{
+    _value = 0;
+}
+
+void Counter::Add(uint64_t amount)
+{
+    // Nobody needs these in order, they just need to add up.
+    _value.fetch_add(amount, memory_order_relaxed);
+}
+
+uint64_t Counter::Get()
+{
+    return _value.load(memory_order_relaxed);
+}
+
+Gauge::Gauge()
+{
+    _value = 0;
+}
+
+void Gauge::Set(double value)
+{
+    _value.store(value, memory_order_relaxed);
+}
+
+double Gauge::Get()
+{
+    return _value.load(memory_order_relaxed);
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+    for(atomic<uint64_t>& bucket : _buckets)
+    {
+        bucket = 0;
+    }
+
+    _count = 0;
+    _sum = 0;
+    _max = 0;
+}
+
+void LatencyHistogram::Record(uint64_t value)
+{
+    _buckets[GetBucket(value)].fetch_add(1, memory_order_relaxed);
+    _count.fetch_add(1, memory_order_relaxed);
+    _sum.fetch_add(value, memory_order_relaxed);
+
+    uint64_t currentMax = _max.load(memory_order_relaxed);
+    while(value > currentMax && !_max.compare_exchange_weak(currentMax, value, memory_order_relaxed)) { }
+}
+
+int LatencyHistogram::GetBucket(uint64_t value)
+{
+    // Small values get a bucket each. After that every power of two is split into the same number of buckets,
+    // so the error stays around 6% no matter how big the value is.
+    uint64_t subBuckets = 1 << HISTOGRAM_SUB_BUCKET_BITS;
+    if(value < subBuckets)
+    {
+        return value;
+    }
+
+    int magnitude = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BUCKET_BITS + 1;
+    if(magnitude > HISTOGRAM_MAGNITUDES)
+    {
+        return ((HISTOGRAM_MAGNITUDES + 1) << HISTOGRAM_SUB_BUCKET_BITS) - 1;
+    }
+
+    int subBucket = (value >> (magnitude - 1)) - subBuckets;
+    return (magnitude << HISTOGRAM_SUB_BUCKET_BITS) + subBucket;
+}
+
+uint64_t LatencyHistogram::GetBucketValue(int bucket)
+{
+    // This is the smallest value that lands in the bucket.
+    uint64_t subBuckets = 1 << HISTOGRAM_SUB_BUCKET_BITS;
+    int magnitude = bucket >> HISTOGRAM_SUB_BUCKET_BITS;
+    uint64_t subBucket = bucket & (subBuckets - 1);
+    if(magnitude == 0)
+    {
+        return subBucket;
+    }
+
+    return (subBuckets + subBucket) << (magnitude - 1);
+}
+
+HistogramSummary LatencyHistogram::Summarize()
+{
+    HistogramSummary summary = { };
+    int numBuckets = (HISTOGRAM_MAGNITUDES + 1) << HISTOGRAM_SUB_BUCKET_BITS;
+    vector<uint64_t> buckets(numBuckets);
+    uint64_t count = 0;
+    for(int i = 0; i < numBuckets; i++)
+    {
+        buckets[i] = _buckets[i].load(memory_order_relaxed);
+        count += buckets[i];
+    }
+
+    summary.count = count;
+    summary.max = _max.load(memory_order_relaxed);
+    if(!count)
+    {
+        return summary;
+    }
+
+    summary.mean = _sum.load(memory_order_relaxed) / (double)_count.load(memory_order_relaxed);
+
+    // Walk the buckets until we pass each percentile.
+    uint64_t seen = 0;
+    uint64_t p50 = (count * 50 + 99) / 100;
+    uint64_t p90 = (count * 90 + 99) / 100;
+    uint64_t p99 = (count * 99 + 99) / 100;
+    for(int i = 0; i < numBuckets; i++)
+    {
+        if(!buckets[i])
+        {
+            continue;
+        }
+
+        // Report the middle of the bucket, it is the best guess we have.
+        uint64_t value = min((GetBucketValue(i) + GetBucketValue(i + 1)) / 2, summary.max);
+        if(seen < p50 && seen + buckets[i] >= p50)
+        {
+            summary.p50 = value;
+        }
+
+        if(seen < p90 && seen + buckets[i] >= p90)
+        {
+            summary.p90 = value;
+        }
+
+        if(seen < p99 && seen + buckets[i] >= p99)
+        {
+            summary.p99 = value;
+        }
+
+        seen += buckets[i];
+    }
+
+    return summary;
+}
+
+LatencyTimer::LatencyTimer(LatencyHistogram& histogram)
+{
+    _histogram = &histogram;
+    _start = chrono::steady_clock::now();
+    _isStopped = false;
+}
+
+uint64_t LatencyTimer::Stop()
+{
+    uint64_t elapsed = chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now() - _start).count();
+    if(!_isStopped)
+    {
+        _histogram->Record(elapsed);
+        _isStopped = true;
+    }
+
+    return elapsed;
+}
+
+LatencyTimer::~LatencyTimer()
+{
+    Stop();
+}
+
+MetricsRegistry& MetricsRegistry::Instance()
+{
+    static MetricsRegistry* instance = new MetricsRegistry();
+    return *instance;
+}
+
+MetricsRegistry::MetricsRegistry()
+{
+    _isReporting = false;
+}
+
+Counter& MetricsRegistry::GetCounter(string name)
+{
+    // Metrics live forever, so callers can hang on to the reference and skip the lookup.
+    lock_guard<mutex> lock(_metricsLock);
+    Counter*& counter = _counters[name];
+    if(!counter)
+    {
+        counter = new Counter();
+    }
+
+    return *counter;
+}
+
+Gauge& MetricsRegistry::GetGauge(string name)
+{
+    lock_guard<mutex> lock(_metricsLock);
+    Gauge*& gauge = _gauges[name];
+    if(!gauge)
+    {
+        gauge = new Gauge();
+    }
+
+    return *gauge;
+}
+
+LatencyHistogram& MetricsRegistry::GetHistogram(string name)
+{
+    lock_guard<mutex> lock(_metricsLock);
+    LatencyHistogram*& histogram = _histograms[name];
+    if(!histogram)
+    {
+        histogram = new LatencyHistogram();
+    }
+
+    return *histogram;
+}
+
+string MetricsRegistry::BuildSnapshot()
+{
+    lock_guard<mutex> lock(_metricsLock);
+
+    // One json object per snapshot, all on one line.
+    stringstream ss;
+    ss << "{\"timestamp_us\":" << chrono::duration_cast<chrono::microseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+
+    ss << ",\"counters\":{";
+    bool first = true;
+    for(auto& counter : _counters)
+    {
+        ss << (first ? "" : ",") << '"' << counter.first << "\":" << counter.second->Get();
+        first = false;
+    }
+
+    ss << "},\"gauges\":{";
+    first = true;
+    for(auto& gauge : _gauges)
+    {
+        ss << (first ? "" : ",") << '"' << gauge.first << "\":" << gauge.second->Get();
+        first = false;
+    }
+
+    ss << "},\"histograms\":{";
+    first = true;
+    for(auto& histogram : _histograms)
+    {
+        HistogramSummary summary = histogram.second->Summarize();
+        ss << (first ? "" : ",") << '"' << histogram.first << "\":{"
+            << "\"count\":" << summary.count
+            << ",\"mean\":" << summary.mean
+            << ",\"p50\":" << summary.p50
+            << ",\"p90\":" << summary.p90
+            << ",\"p99\":" << summary.p99
+            << ",\"max\":" << summary.max << '}';
+        first = false;
+    }
+
+    ss << "}}";
+    return ss.str();
+}
+
+void MetricsRegistry::StartReporting(string path, int intervalMs)
+{
+    if(!_isReporting)
+    {
+        _isReporting = true;
+        _stopSignal.Clear();
+        _reportFuture = Executor::Instance().Submit(STATUS_GROUP, [this, path, intervalMs]()
+        {
+            Report(path, intervalMs);
+        });
+    }
+}
+
+void MetricsRegistry::StopReporting()
+{
+    if(_isReporting)
+    {
+        _isReporting = false;
+        _stopSignal.Notify();
+        _reportFuture.wait();
+    }
+}
+
+void MetricsRegistry::Report(string path, int intervalMs)
+{
+    // Paths that start with unix: go to a datagram socket, anything else is a file we append to.
+    bool useSocket = path.rfind("unix:", 0) == 0;
+    int sock = -1;
+    sockaddr_un address = { };
+    ofstream file;
+    if(useSocket)
+    {
+        sock = socket(AF_UNIX, SOCK_DGRAM | SOCK_CLOEXEC, 0);
+        address.sun_family = AF_UNIX;
+        strncpy(address.sun_path, path.substr(5).c_str(), sizeof(address.sun_path) - 1);
+    }
+    else
+    {
+        file.open(path, ofstream::out | ofstream::app);
+    }
+
+    Log("Reporting metrics to " + path + " every " + to_string(intervalMs) + "ms", Debug);
+    while(_isReporting)
+    {
+        _stopSignal.Wait(intervalMs);
+        string snapshot = BuildSnapshot();
+        if(useSocket)
+        {
+            // Nobody listening is fine, the snapshot just goes nowhere.
+            sendto(sock, snapshot.c_str(), snapshot.size(), MSG_DONTWAIT, (sockaddr*)&address, sizeof(address));
+        }
+        else
+        {
+            file << snapshot << endl;
+        }
+    }
+
+    if(sock >= 0)
+    {
+        close(sock);
+    }
+}
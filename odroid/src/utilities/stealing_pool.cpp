@@ -0,0 +1,204 @@
+#include "utilities.hpp"
+
+using namespace tsw::utilities;
+using namespace std;
+
+thread_local int _currentStealingWorker = -1;
+
+StealingPool::StealingPool(string name, PriorityClass priority, int numWorkers)
+{
+    _name = name;
+    _priority = priority;
+    _queuedChunks = 0;
+    _isRunning = true;
+    _config.fifoPriority = 0;
+
+    for(int i = 0; i < numWorkers; i++)
+    {
+        _queues.push_back(new WorkerQueue());
+    }
+
+    for(int i = 0; i < numWorkers; i++)
+    {
+        _workers.push_back(thread(&StealingPool::RunWorker, this, i));
+    }
+}
+
+int StealingPool::GetWorkerCount()
+{
+    return _workers.size();
+}
+
+int StealingPool::GetCurrentWorker()
+{
+    return _currentStealingWorker;
+}
+
+void StealingPool::ParallelFor(int start, int end, function<void(int, int)> body)
+{
+    int range = end - start;
+    if(range <= 0)
+    {
+        return;
+    }
+
+    // Not worth waking anybody up for.
+    if(range == 1 || _workers.empty())
+    {
+        body(start, end);
+        return;
+    }
+
+    // A few chunks per worker lets the fast ones steal from the slow ones.
+    // The last worker out still touches this after we may have returned, so it has to outlive us.
+    int numChunks = min(range, (int)_workers.size() * 4);
+    shared_ptr<ChunkGroup> group = make_shared<ChunkGroup>();
+    group->remaining = numChunks;
+
+    for(int i = 0; i < numChunks; i++)
+    {
+        Chunk chunk;
+        chunk.start = start + (long)range * i / numChunks;
+        chunk.end = start + (long)range * (i + 1) / numChunks;
+        chunk.body = &body;
+        chunk.group = group;
+
+        WorkerQueue* queue = _queues[i % _queues.size()];
+        lock_guard<mutex> lock(queue->lock);
+        queue->chunks.push_back(chunk);
+    }
+
+    {
+        lock_guard<mutex> lock(_sleepLock);
+        _queuedChunks += numChunks;
+    }
+    _sleepCondition.notify_all();
+
+    // We may as well help out instead of just sitting here.
+    while(group->remaining > 0 && TryRunChunk(_currentStealingWorker)) { }
+
+    // Somebody else is finishing the last chunks.
+    while(group->remaining > 0)
+    {
+        group->doneSignal.Wait();
+    }
+}
+
+void StealingPool::RunWorker(int workerNum)
+{
+    _currentStealingWorker = workerNum;
+    unique_lock<mutex> configLock(_configLock);
+    pid_t threadId = InitializeWorkerThread(_name + to_string(workerNum), _priority, _config);
+    _workerThreadIds.push_back(threadId);
+    configLock.unlock();
+
+    while(true)
+    {
+        if(TryRunChunk(workerNum))
+        {
+            continue;
+        }
+
+        unique_lock<mutex> lock(_sleepLock);
+        _sleepCondition.wait(lock, [this]()
+        {
+            return _queuedChunks > 0 || !_isRunning;
+        });
+
+        if(!_isRunning)
+        {
+            break;
+        }
+    }
+
+    FinishWorkerThread(threadId);
+}
+
+void StealingPool::Configure(ThreadConfig config)
+{
+    lock_guard<mutex> lock(_configLock);
+    _config = config;
+    for(int i = 0; i < _workerThreadIds.size(); i++)
+    {
+        ApplyThreadSettings(_workerThreadIds[i], _name, _priority, _config);
+    }
+}
+
+bool StealingPool::TryRunChunk(int workerNum)
+{
+    Chunk chunk;
+    bool found = false;
+
+    // Our own work comes off the front.
+    if(workerNum >= 0)
+    {
+        WorkerQueue* own = _queues[workerNum];
+        lock_guard<mutex> lock(own->lock);
+        if(!own->chunks.empty())
+        {
+            chunk = own->chunks.front();
+            own->chunks.pop_front();
+            found = true;
+        }
+    }
+
+    // Steal from the back of everybody else so we don't fight the owner over the same chunk.
+    for(int i = 1; i <= _queues.size() && !found; i++)
+    {
+        int victim = (max(workerNum, 0) + i) % _queues.size();
+        WorkerQueue* other = _queues[victim];
+        lock_guard<mutex> lock(other->lock);
+        if(!other->chunks.empty())
+        {
+            chunk = other->chunks.back();
+            other->chunks.pop_back();
+            found = true;
+        }
+    }
+
+    if(!found)
+    {
+        return false;
+    }
+
+    _queuedChunks--;
+    RunChunk(chunk);
+    return true;
+}
+
+void StealingPool::RunChunk(Chunk& chunk)
+{
+    try
+    {
+        (*chunk.body)(chunk.start, chunk.end);
+    }
+    catch(exception& e)
+    {
+        Log("Parallel chunk failed: " + string(e.what()), tsw::utilities::Error);
+    }
+
+    // The last one out lets the caller know.
+    if(--chunk.group->remaining == 0)
+    {
+        chunk.group->doneSignal.Notify();
+    }
+}
+
+StealingPool::~StealingPool()
+{
+    {
+        lock_guard<mutex> lock(_sleepLock);
+        _isRunning = false;
+    }
+    _sleepCondition.notify_all();
+
+    for(thread& worker : _workers)
+    {
+        worker.join();
+    }
+
+    for(WorkerQueue* queue : _queues)
+    {
+        delete queue;
+    }
+}
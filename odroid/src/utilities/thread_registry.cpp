@@ -0,0 +1,118 @@
+#include "utilities.hpp"
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+
+using namespace tsw::utilities;
+using namespace std;
+
+ThreadRegistry& ThreadRegistry::Instance()
+{
+    static ThreadRegistry* instance = new ThreadRegistry();
+    return *instance;
+}
+
+ThreadRegistry::ThreadRegistry() { }
+
+void ThreadRegistry::Register(string name, pid_t threadId)
+{
+    lock_guard<mutex> lock(_threadsLock);
+    NamedThread namedThread;
+    namedThread.name = name;
+    namedThread.threadId = threadId;
+    namedThread.coreSamples = vector<unsigned long>(max(1L, sysconf(_SC_NPROCESSORS_CONF)), 0);
+    _threads[threadId] = namedThread;
+}
+
+void ThreadRegistry::Unregister(pid_t threadId)
+{
+    // Hang on to what it did so it still shows up in the report.
+    lock_guard<mutex> lock(_threadsLock);
+    auto found = _threads.find(threadId);
+    if(found != _threads.end())
+    {
+        _finishedThreads.push_back(found->second);
+        _threads.erase(found);
+    }
+}
+
+void ThreadRegistry::Sample()
+{
+    lock_guard<mutex> lock(_threadsLock);
+    for(auto& entry : _threads)
+    {
+        int core = ReadLastCore(entry.first);
+        if(core >= 0 && core < entry.second.coreSamples.size())
+        {
+            entry.second.coreSamples[core]++;
+        }
+    }
+}
+
+string ThreadRegistry::BuildCoreReport()
+{
+    lock_guard<mutex> lock(_threadsLock);
+    vector<NamedThread> threads = _finishedThreads;
+    for(auto& entry : _threads)
+    {
+        threads.push_back(entry.second);
+    }
+
+    // One line per thread with the share of samples it spent on each core.
+    stringstream ss;
+    ss << "Thread core usage:";
+    for(NamedThread& namedThread : threads)
+    {
+        unsigned long total = 0;
+        for(unsigned long samples : namedThread.coreSamples)
+        {
+            total += samples;
+        }
+
+        ss << endl << namedThread.name << " (" << namedThread.threadId << "):";
+        for(int core = 0; core < namedThread.coreSamples.size(); core++)
+        {
+            if(namedThread.coreSamples[core])
+            {
+                ss << " cpu" << core << "=" << (100 * namedThread.coreSamples[core] / total) << "%";
+            }
+        }
+
+        if(!total)
+        {
+            ss << " no samples";
+        }
+    }
+
+    return ss.str();
+}
+
+int ThreadRegistry::ReadLastCore(pid_t threadId)
+{
+    // Field 39 of the stat file is the cpu the thread last ran on.
+    ifstream statFile("/proc/self/task/" + to_string(threadId) + "/stat");
+    string stat;
+    if(!getline(statFile, stat))
+    {
+        return -1;
+    }
+
+    // The name can have spaces in it, so start counting after the closing paren.
+    size_t nameEnd = stat.rfind(')');
+    if(nameEnd == string::npos)
+    {
+        return -1;
+    }
+
+    stringstream fields(stat.substr(nameEnd + 2));
+    string field;
+    for(int i = 3; i <= 39 && fields >> field; i++)
+    {
+        if(i == 39)
+        {
+            return stoi(field);
+        }
+    }
+
+    return -1;
+}
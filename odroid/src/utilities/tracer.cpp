@@ -0,0 +1,174 @@
+#include "utilities.hpp"
+#include <fstream>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+using namespace tsw::utilities;
+using namespace std;
+
+thread_local TraceBuffer* _threadTraceBuffer = nullptr;
+thread_local int64_t _currentTraceFrame = -1;
+
+Tracer& Tracer::Instance()
+{
+    static Tracer* instance = new Tracer();
+    return *instance;
+}
+
+Tracer::Tracer()
+{
+    _isTracing = false;
+}
+
+void Tracer::Start()
+{
+    // Throw out whatever we had from the last capture.
+    lock_guard<mutex> lock(_buffersLock);
+    for(TraceBuffer* buffer : _buffers)
+    {
+        lock_guard<mutex> bufferLock(buffer->lock);
+        buffer->events.clear();
+    }
+
+    _isTracing = true;
+    Log("Tracing started", Debug);
+}
+
+void Tracer::Stop()
+{
+    _isTracing = false;
+    Log("Tracing stopped", Debug);
+}
+
+bool Tracer::IsTracing()
+{
+    return _isTracing.load(memory_order_relaxed);
+}
+
+uint64_t Tracer::NowUs()
+{
+    return GetMonotonicTimeUs();
+}
+
+int64_t Tracer::GetCurrentFrame()
+{
+    return _currentTraceFrame;
+}
+
+void Tracer::SetCurrentFrame(int64_t frameIndex)
+{
+    _currentTraceFrame = frameIndex;
+}
+
+void Tracer::Record(const char* name, uint64_t startUs, uint64_t endUs, int64_t frameIndex)
+{
+    TraceBuffer* buffer = GetThreadBuffer();
+
+    // Only this thread ever adds to its buffer, so the lock is only contended while writing the file.
+    lock_guard<mutex> lock(buffer->lock);
+    if(buffer->events.size() < TRACE_BUFFER_CAPACITY)
+    {
+        TraceEvent event;
+        event.name = name;
+        event.startUs = startUs;
+        event.durationUs = endUs - startUs;
+        event.frameIndex = frameIndex;
+        buffer->events.push_back(event);
+    }
+}
+
+TraceBuffer* Tracer::GetThreadBuffer()
+{
+    if(!_threadTraceBuffer)
+    {
+        // First span on this thread. Give it a buffer that outlives it so we can still write it out later.
+        TraceBuffer* buffer = new TraceBuffer();
+        buffer->threadId = syscall(SYS_gettid);
+        char threadName[16];
+        pthread_getname_np(pthread_self(), threadName, sizeof(threadName));
+        buffer->threadName = threadName;
+        buffer->events.reserve(1024);
+
+        lock_guard<mutex> lock(_buffersLock);
+        _buffers.push_back(buffer);
+        _threadTraceBuffer = buffer;
+    }
+
+    return _threadTraceBuffer;
+}
+
+void Tracer::WriteChromeTrace(string fileName)
+{
+    ofstream file(fileName, ofstream::out | ofstream::trunc);
+    if(!file.is_open())
+    {
+        Log("Could not open trace file " + fileName, tsw::utilities::Error);
+        return;
+    }
+
+    // This is the trace event format that chrome://tracing and perfetto both read.
+    pid_t processId = getpid();
+    file << "{\"traceEvents\":[";
+    bool first = true;
+    size_t numEvents = 0;
+
+    lock_guard<mutex> lock(_buffersLock);
+    for(TraceBuffer* buffer : _buffers)
+    {
+        lock_guard<mutex> bufferLock(buffer->lock);
+        file << (first ? "" : ",") << "\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":" << processId << ",\"tid\":" << buffer->threadId
+            << ",\"args\":{\"name\":\"" << buffer->threadName << "\"}}";
+        first = false;
+
+        for(TraceEvent& event : buffer->events)
+        {
+            file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":" << processId << ",\"tid\":" << buffer->threadId
+                << ",\"ts\":" << event.startUs << ",\"dur\":" << event.durationUs;
+            if(event.frameIndex >= 0)
+            {
+                file << ",\"args\":{\"imageIndex\":" << event.frameIndex << "}";
+            }
+            file << '}';
+        }
+
+        numEvents += buffer->events.size();
+    }
+
+    file << "\n]}" << endl;
+    Log("Wrote " + to_string(numEvents) + " trace events to " + fileName, Debug);
+}
+
+TraceSpan::TraceSpan(const char* name) : TraceSpan(name, Tracer::GetCurrentFrame()) { }
+
+TraceSpan::TraceSpan(const char* name, int64_t frameIndex)
+{
+    // When we are not tracing, this is all the span costs.
+    _isTracing = Tracer::Instance().IsTracing();
+    if(_isTracing)
+    {
+        _name = name;
+        _frameIndex = frameIndex;
+        _startUs = Tracer::NowUs();
+    }
+}
+
+TraceSpan::~TraceSpan()
+{
+    if(_isTracing)
+    {
+        Tracer::Instance().Record(_name, _startUs, Tracer::NowUs(), _frameIndex);
+    }
+}
+
+TraceFrameScope::TraceFrameScope(int64_t frameIndex)
+{
+    // Everything this thread does until we go out of scope belongs to this frame.
+    _previousFrame = Tracer::GetCurrentFrame();
+    Tracer::SetCurrentFrame(frameIndex);
+}
+
+TraceFrameScope::~TraceFrameScope()
+{
+    Tracer::SetCurrentFrame(_previousFrame);
+}
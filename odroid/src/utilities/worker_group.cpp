@@ -0,0 +1,114 @@
+#include "utilities.hpp"
+
+using namespace tsw::utilities;
+using namespace std;
+
+WorkerGroup::WorkerGroup(string name, PriorityClass priority)
+{
+    Name = name;
+    Priority = priority;
+    _idleWorkers = 0;
+    _isRunning = true;
+    _config.fifoPriority = 0;
+}
+
+future<void> WorkerGroup::Submit(function<void()> task)
+{
+    packaged_task<void()> packagedTask(task);
+    future<void> taskFuture = packagedTask.get_future();
+
+    unique_lock<mutex> lock(_tasksLock);
+    if(!_isRunning)
+    {
+        throw runtime_error("Cannot submit work to worker group " + Name + " after it has been shut down.");
+    }
+
+    _tasks.push(move(packagedTask));
+
+    // Most of what gets submitted here runs for as long as the subsystem is on.
+    // If nobody is free to pick this up, the group grows instead of making it wait behind a loop that never ends.
+    if(_tasks.size() > _idleWorkers)
+    {
+        int workerNum = _workers.size();
+        Log("Worker group " + Name + " growing to " + to_string(workerNum + 1) + " workers", Debug);
+        _workers.push_back(thread(&WorkerGroup::RunWorker, this, workerNum));
+    }
+
+    lock.unlock();
+    _tasksCondition.notify_one();
+    return taskFuture;
+}
+
+int WorkerGroup::GetWorkerCount()
+{
+    lock_guard<mutex> lock(_tasksLock);
+    return _workers.size();
+}
+
+void WorkerGroup::RunWorker(int workerNum)
+{
+    unique_lock<mutex> lock(_tasksLock);
+    pid_t threadId = InitializeWorkerThread(Name + to_string(workerNum), Priority, _config);
+    _workerThreadIds.push_back(threadId);
+
+    while(true)
+    {
+        // Park until there is something to do.
+        _idleWorkers++;
+        _tasksCondition.wait(lock, [this]()
+        {
+            return !_tasks.empty() || !_isRunning;
+        });
+        _idleWorkers--;
+
+        if(_tasks.empty())
+        {
+            // We are shutting down and there is nothing left.
+            break;
+        }
+
+        packaged_task<void()> task = move(_tasks.front());
+        _tasks.pop();
+
+        // Exceptions end up in the task's future, so the caller still sees them.
+        lock.unlock();
+        task();
+        lock.lock();
+    }
+
+    FinishWorkerThread(threadId);
+}
+
+void WorkerGroup::Configure(ThreadConfig config)
+{
+    lock_guard<mutex> lock(_tasksLock);
+    _config = config;
+
+    // Workers that are already going need to be moved over too.
+    for(int i = 0; i < _workerThreadIds.size(); i++)
+    {
+        ApplyThreadSettings(_workerThreadIds[i], Name, Priority, _config);
+    }
+}
+
+void WorkerGroup::Shutdown()
+{
+    unique_lock<mutex> lock(_tasksLock);
+    _isRunning = false;
+    lock.unlock();
+    _tasksCondition.notify_all();
+
+    // Don't hold the lock while joining, workers need it to see that we stopped.
+    for(thread& worker : _workers)
+    {
+        if(worker.joinable())
+        {
+            worker.join();
+        }
+    }
+}
+
+WorkerGroup::~WorkerGroup()
+{
+    Shutdown();
+}
@@ -21,10 +21,37 @@ string MotorValuesToMovement(vector<uchar> motorValues)
     return "H: " + to_string(hMove) + "\tV: " + to_string(vMove);
 }
 
+void RunTrajectory(CommandAgent& tswAgent, vector<int> dwells, int loops, atomic<uint>& motion, uint trajectoryMotion)
+{
+    // Each leg takes about as long as a sync move, plus however long it sits at the end.
+    for(int loop = 0; loop < loops; loop++)
+    {
+        for(int dwell : dwells)
+        {
+            sleep(1);
+            this_thread::sleep_for(chrono::milliseconds(dwell));
+
+            // Anything else that moves the motors cuts the trajectory short, and then there is no success.
+            if(motion != trajectoryMotion)
+            {
+                return;
+            }
+        }
+    }
+
+    cout << "MOTORS\tTrajectory complete" << endl;
+    tswAgent.SendResponse({ 0b10000001 });
+}
+
 void StartMotorListener(CommandAgent tswAgent)
 {
     async(launch::async, [&]()
     {
+        // Every motion replaces the last one, so each gets a number and anything still running checks it is the latest.
+        atomic<uint> motion(0);
+
+        // The dwell of each waypoint, in ms. The positions don't matter in here.
+        vector<int> trajectory;
         while(true)
         {
             // Wait for the tsw to send a motor command.
@@ -38,24 +65,89 @@ void StartMotorListener(CommandAgent tswAgent)
             switch(command->action)
             {
                 case RelativeMoveAsynchronous:
+                    motion++;
                     cout << "MOTORS\tAsync Rel Move\t" << MotorValuesToMovement(command->args);
                     break;
 
                 case AbsoluteMoveAsynchronous:
+                    motion++;
                     cout << "MOTORS\tAsync Abs Move\t" << MotorValuesToMovement(command->args);
                     break;
 
                 case RelativeMoveSynchronous:
+                    motion++;
                     cout << "MOTORS\tSync Rel Move\t" << MotorValuesToMovement(command->args);
                     sleep(1);
-                    tswAgent.SendResponse(0b10000001);
+                    tswAgent.SendResponse({ 0b10000001 });
                     break;
 
                 case AbsoluteMoveSynchronous:
+                    motion++;
                     cout << "MOTORS\tSync Abs Move\t" << MotorValuesToMovement(command->args);
                     sleep(1);
-                    tswAgent.SendResponse(0b10000001);
+                    tswAgent.SendResponse({ 0b10000001 });
+                    break;
+
+                case Trajectory:
+                    cout << "MOTORS\tTrajectory\tOpcode: " << (int)command->args[0];
+                    switch(command->args[0])
+                    {
+                        case TrajectoryClear:
+                            motion++;
+                            trajectory.clear();
+                            break;
+
+                        case TrajectoryAddWaypoint:
+                            cout << "\t" << MotorValuesToMovement(vector<uchar>(command->args.begin() + 1, command->args.end()));
+                            if(trajectory.size() < TRAJECTORY_MAX_WAYPOINTS)
+                            {
+                                trajectory.push_back(0);
+                            }
+                            break;
+
+                        case TrajectorySetDwell:
+                            cout << "\tDwell: " << (command->args[1] << 8 | command->args[2]) << "ms";
+                            if(!trajectory.empty())
+                            {
+                                trajectory.back() = command->args[1] << 8 | command->args[2];
+                            }
+                            break;
+
+                        case TrajectoryExecute:
+                        {
+                            // No loops means go until aborted, and that never gets a success.
+                            int loops = command->args[1];
+                            uint trajectoryMotion = ++motion;
+                            cout << "\tLoops: " << loops;
+                            if(loops > 0 && !trajectory.empty())
+                            {
+                                thread(RunTrajectory, ref(tswAgent), trajectory, loops, ref(motion), trajectoryMotion).detach();
+                            }
+                            break;
+                        }
+
+                        case TrajectoryAbort:
+                            motion++;
+                            break;
+                    }
+                    break;
+
+                case SetVelocity:
+                {
+                    // The motors stop on their own once the timeout runs out, unless something else comes in first.
+                    int timeoutMs = command->args[6] * VELOCITY_TIMEOUT_UNIT_MS;
+                    uint velocityMotion = ++motion;
+                    cout << "MOTORS\tVelocity\t" << MotorValuesToMovement(command->args) << "\tTimeout: " << timeoutMs << "ms";
+                    thread([&motion, velocityMotion, timeoutMs]()
+                    {
+                        this_thread::sleep_for(chrono::milliseconds(timeoutMs));
+                        if(motion == velocityMotion)
+                        {
+                            cout << "MOTORS\tVelocity timed out, stopping" << endl;
+                        }
+                    }).detach();
                     break;
+                }
             }
 
             // Deallocate!